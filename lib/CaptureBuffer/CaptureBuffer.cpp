@@ -0,0 +1,246 @@
+#include <CaptureBuffer.h>
+
+// Exponent needed by the largest possible delta of 25 bits, between two 24 bit readings
+#define CAPTURE_MAX_EXPONENT 10
+// Range of the 16 bit mantissas (INT16_MAX is not defined for C++ by avr-libc)
+#define CAPTURE_MANTISSA_MAX 32767L
+#define CAPTURE_MANTISSA_MIN -32768L
+
+// value / 2^exponent, rounded to the nearest
+static long roundShift(long value, uint8_t exponent)
+{
+    if (exponent == 0)
+    {
+        return value;
+    }
+
+    return (value + (1L << (exponent - 1))) >> exponent;
+}
+
+CaptureBuffer::CaptureBuffer(int _frames)
+{
+    if (_frames > CAPTURE_MAX_FRAMES)
+    {
+        _frames = CAPTURE_MAX_FRAMES;
+    }
+    if (_frames < 2)
+    {
+        _frames = 2;
+    }
+
+    frames = _frames;
+
+    disarm();
+}
+
+CaptureBuffer::~CaptureBuffer()
+{
+}
+
+void CaptureBuffer::arm(int _post_frames)
+{
+    disarm();
+
+    if (_post_frames > frames - 1)
+    {
+        _post_frames = frames - 1;
+    }
+    if (_post_frames < 0)
+    {
+        _post_frames = 0;
+    }
+
+    post_frames = _post_frames;
+    state = CAPTURE_ARMED;
+}
+
+void CaptureBuffer::disarm()
+{
+    head = 0;
+    stored = 0;
+    post_remaining = 0;
+    trigger_time = 0;
+    state = CAPTURE_IDLE;
+
+    rewind();
+}
+
+void CaptureBuffer::trigger(unsigned long time)
+{
+    if (state != CAPTURE_ARMED)
+    {
+        return;
+    }
+
+    trigger_time = time;
+    post_remaining = post_frames;
+    state = (post_remaining == 0) ? CAPTURE_DONE : CAPTURE_TRIGGERED;
+}
+
+void CaptureBuffer::storeDeltas(int slot, const long *values)
+{
+    long delta[CAPTURE_CHANNELS];
+    uint8_t exponent = 0;
+
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        delta[i] = values[i] - last[i];
+
+        // the exponent only grows, so it ends up fitting the largest delta of the frame
+        while (exponent < CAPTURE_MAX_EXPONENT &&
+               (roundShift(delta[i], exponent) > CAPTURE_MANTISSA_MAX ||
+                roundShift(delta[i], exponent) < CAPTURE_MANTISSA_MIN))
+        {
+            exponent++;
+        }
+    }
+
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        long mantissa = roundShift(delta[i], exponent);
+
+        deltas[slot][i] = (int16_t)mantissa;
+        // the next delta is taken from the stored value, so the rounding does not accumulate
+        last[i] += mantissa << exponent;
+    }
+
+    exponents[slot] = exponent;
+}
+
+void CaptureBuffer::addFrame(const long *values)
+{
+    if (state != CAPTURE_ARMED && state != CAPTURE_TRIGGERED)
+    {
+        return;
+    }
+
+    if (stored == 0)
+    {
+        stored = 1;
+
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            first[i] = values[i];
+            last[i] = values[i];
+            deltas[head][i] = 0;
+        }
+        exponents[head] = 0;
+    }
+    else if (stored == frames)
+    {
+        // Drops the oldest frame: the next one becomes the absolute reference
+        int next = (head + 1) % frames;
+
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            first[i] += (long)deltas[next][i] << exponents[next];
+        }
+
+        storeDeltas(head, values);
+        head = next;
+    }
+    else
+    {
+        storeDeltas((head + stored) % frames, values);
+        stored++;
+    }
+
+    if (state == CAPTURE_TRIGGERED && --post_remaining <= 0)
+    {
+        state = CAPTURE_DONE;
+        rewind();
+    }
+}
+
+uint8_t CaptureBuffer::getState()
+{
+    return state;
+}
+
+bool CaptureBuffer::isDone()
+{
+    return state == CAPTURE_DONE;
+}
+
+int CaptureBuffer::getFrames()
+{
+    return frames;
+}
+
+int CaptureBuffer::getStored()
+{
+    return stored;
+}
+
+int CaptureBuffer::getTriggerIndex()
+{
+    if (state != CAPTURE_DONE)
+    {
+        return -1;
+    }
+
+    return stored - 1 - post_frames;
+}
+
+unsigned long CaptureBuffer::getTriggerTime()
+{
+    return trigger_time;
+}
+
+void CaptureBuffer::rewind()
+{
+    read_position = 0;
+}
+
+bool CaptureBuffer::readFrame(long *values)
+{
+    if (state != CAPTURE_DONE || read_position >= stored)
+    {
+        return false;
+    }
+
+    int slot = (head + read_position) % frames;
+
+    // recording is over, so last is free to accumulate the frames read
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        if (read_position == 0)
+        {
+            last[i] = first[i];
+        }
+        else
+        {
+            last[i] += (long)deltas[slot][i] << exponents[slot];
+        }
+
+        values[i] = last[i];
+    }
+
+    read_position++;
+    return true;
+}
+
+bool CaptureBuffer::frameAt(int index, long *values)
+{
+    if (state != CAPTURE_DONE || index < 0 || index >= stored)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        values[i] = first[i];
+    }
+
+    for (int position = 1; position <= index; position++)
+    {
+        int slot = (head + position) % frames;
+
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            values[i] += (long)deltas[slot][i] << exponents[slot];
+        }
+    }
+
+    return true;
+}
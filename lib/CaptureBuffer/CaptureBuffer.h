@@ -0,0 +1,85 @@
+#ifndef CAPTUREBUFFER_h
+#define CAPTUREBUFFER_h
+
+#include <stdint.h>
+
+#define CAPTURE_CHANNELS 6
+
+// Largest capture accepted. The storage is static, so the buffer does not use the heap, and is
+// always sized for this many frames
+#define CAPTURE_MAX_FRAMES 12
+
+enum CaptureState
+{
+    CAPTURE_IDLE = 0,      // not recording
+    CAPTURE_ARMED = 1,     // recording the pre-trigger frames, waiting for the trigger
+    CAPTURE_TRIGGERED = 2, // recording the post-trigger frames
+    CAPTURE_DONE = 3       // frozen, ready to be downloaded
+};
+
+// Circular buffer of raw six-channel frames around a trigger.
+//
+// To fit the atmega328 SRAM each frame is stored as 16 bit deltas from the previous one, in block
+// floating point: the six deltas share an exponent, chosen so the largest one fits in 16 bits
+// (13 bytes per frame instead of 24). Small deltas are exact. A large step is stored in a single
+// frame, rounded to 2^exponent counts (a few counts for a full scale step), and the rounding is
+// carried into the next delta instead of accumulating. Only the oldest frame is kept in absolute
+// values.
+class CaptureBuffer
+{
+private:
+    int frames;
+    int16_t deltas[CAPTURE_MAX_FRAMES][CAPTURE_CHANNELS];
+    uint8_t exponents[CAPTURE_MAX_FRAMES];
+
+    long first[CAPTURE_CHANNELS]; // absolute values of the oldest stored frame
+    // reconstructed values of the newest stored frame while recording; once done, the values of
+    // the last frame read
+    long last[CAPTURE_CHANNELS];
+
+    int head = 0;   // slot of the oldest stored frame
+    int stored = 0; // frames currently stored
+
+    uint8_t state = CAPTURE_IDLE;
+    int post_frames = 0;
+    int post_remaining = 0;
+    unsigned long trigger_time = 0;
+
+    int read_position = 0;
+
+    // stores values - last in slot, and moves last to the values as stored
+    void storeDeltas(int slot, const long *values);
+
+public:
+    // frames is limited to 2..CAPTURE_MAX_FRAMES
+    CaptureBuffer(int frames);
+    virtual ~CaptureBuffer();
+
+    // clears the buffer and starts recording; post_frames = frames kept after the trigger
+    void arm(int post_frames);
+    // stops recording and clears the buffer
+    void disarm();
+    // marks the last added frame as the trigger frame; the buffer is frozen after the
+    // post-trigger frames. Ignored if not armed
+    void trigger(unsigned long time);
+
+    // records a frame while armed or triggered
+    void addFrame(const long *values);
+
+    uint8_t getState();
+    bool isDone();
+    int getFrames();
+    int getStored();
+    // position of the trigger frame among the stored frames; -1 until done
+    int getTriggerIndex();
+    unsigned long getTriggerTime();
+
+    // sequential download, from the oldest frame; only once done
+    void rewind();
+    bool readFrame(long *values);
+    // frame at a position among the stored frames (0 = oldest), without moving the download;
+    // only once done. Rebuilt from the oldest frame, so slower than readFrame
+    bool frameAt(int index, long *values);
+};
+
+#endif /* CAPTUREBUFFER_h */
@@ -0,0 +1,109 @@
+#include <ClockSync.h>
+
+// Shortest time between the two references of a skew measurement. A latency of a few hundred
+// us is then a skew error of tens of ppm, instead of thousands over 100 ms. The first
+// measurement is shorter, so the offset does not drift for long before the skew is known
+#define SKEW_INTERVAL 5000000UL
+#define FIRST_SKEW_INTERVAL 1000000UL
+// Larger skews are measurement errors (a lost or delayed reference); ceramic resonators stay
+// well under 0.5 %
+#define MAX_SKEW 10000L
+// Weight of a new measurement in the skew filter, as a power of two (1/4)
+#define SKEW_FILTER_SHIFT 2
+// Weight of a late reference in the offset, as a power of two (1/16)
+#define OFFSET_FILTER_SHIFT 4
+// Distance from the estimate, in us, above which a reference is not latency but a new clock
+#define RESYNC_LIMIT 20000L
+
+void ClockSync::restart(unsigned long local_time, unsigned long master_time)
+{
+    local_reference = local_time;
+    master_reference = master_time;
+    skew_local_reference = local_time;
+    skew_master_reference = master_time;
+}
+
+void ClockSync::addReference(unsigned long local_time, unsigned long master_time)
+{
+    if (references == 0)
+    {
+        restart(local_time, master_time);
+        references = 1;
+        return;
+    }
+
+    uint32_t estimate = toMaster(local_time);
+    long residual = (int32_t)((uint32_t)master_time - estimate);
+
+    if (residual > RESYNC_LIMIT || residual < -RESYNC_LIMIT)
+    {
+        restart(local_time, master_time);
+        return;
+    }
+
+    // A late local stamp makes the residual negative. Positive residuals are taken whole, so the
+    // estimate follows the earliest stamps; negative ones still move it slowly, which tracks a
+    // master clock running slower than the skew says
+    if (residual < 0)
+    {
+        residual >>= OFFSET_FILTER_SHIFT;
+    }
+
+    local_reference = local_time;
+    master_reference = estimate + residual;
+
+    uint32_t local_interval = (uint32_t)local_time - skew_local_reference;
+
+    if (local_interval >= (references == 1 ? FIRST_SKEW_INTERVAL : SKEW_INTERVAL))
+    {
+        uint32_t master_interval = (uint32_t)master_time - skew_master_reference;
+        long difference = (int32_t)(master_interval - local_interval);
+        long measured = (long)(((int64_t)difference * 1000000) / (int64_t)local_interval);
+
+        if (measured <= MAX_SKEW && measured >= -MAX_SKEW)
+        {
+            if (references == 1)
+            {
+                skew = measured;
+                references = 2;
+            }
+            else
+            {
+                skew += (measured - skew) >> SKEW_FILTER_SHIFT;
+            }
+        }
+
+        skew_local_reference = local_time;
+        skew_master_reference = master_time;
+    }
+}
+
+unsigned long ClockSync::toMaster(unsigned long local_time)
+{
+    if (references == 0)
+    {
+        return local_time;
+    }
+
+    // signed: times taken just before the reference (a frame already being built when the
+    // reference arrived) are negative instead of wrapping to ~2^32
+    long elapsed = (int32_t)((uint32_t)local_time - local_reference);
+    long correction = (long)(((int64_t)elapsed * skew) / 1000000);
+
+    return (uint32_t)(master_reference + elapsed + correction);
+}
+
+bool ClockSync::isSynchronized()
+{
+    return references > 0;
+}
+
+long ClockSync::getSkew()
+{
+    return skew;
+}
+
+long ClockSync::getOffset()
+{
+    return (int32_t)(master_reference - local_reference);
+}
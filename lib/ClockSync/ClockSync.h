@@ -0,0 +1,53 @@
+#ifndef CLOCKSYNC_h
+#define CLOCKSYNC_h
+
+#include <stdint.h>
+
+// Estimates the offset and skew between the local microsecond counter and a master clock, from
+// pairs (local time, master time) taken when the master broadcasts its time.
+//
+// The local time of a pair is stamped in the receive interrupt, which can be held off by other
+// code with the interrupts disabled (a bridge read takes ~0.3 ms), so it is late by a variable
+// latency. The offset is therefore not taken from the last pair alone: each pair is compared with
+// the current estimate, and earlier arrivals are followed at once but later ones only by 1/16.
+// The estimate converges to the pairs with the least latency. The skew, in ppm, is the filtered
+// rate difference between pairs 5 s apart (1 s for the first), so a latency is spread over
+// seconds instead of one interval.
+//
+// With a pair every 100 ms and a third of them delayed by up to 0.3 ms, the stamps follow the
+// master within ~60 us once the skew is known (~10 s), and the skew within ~15 ppm. Before that,
+// a 0.5 % resonator can be off by a few ms for the first second. The constant part of the delay
+// (the transfer of the broadcast itself) is the same on every device that receives it, so it
+// does not affect the alignment between them.
+//
+// Times are unsigned microseconds and wrap at 2^32 like micros(), also where long is wider; a
+// time is converted from its signed distance to the last pair, before or after it, so pairs must
+// arrive more often than every ~35 minutes. A pair far from the estimate (the master clock was
+// set, or pairs stopped for a long time) restarts the offset from it and keeps the skew.
+class ClockSync
+{
+private:
+    // estimate: a local time and the master time it corresponds to
+    uint32_t local_reference = 0;
+    uint32_t master_reference = 0;
+    // reference at the start of the current skew measurement
+    uint32_t skew_local_reference = 0;
+    uint32_t skew_master_reference = 0;
+    long skew = 0; // ppm the master clock runs faster than the local one
+    uint8_t references = 0;
+
+    void restart(unsigned long local_time, unsigned long master_time);
+
+public:
+    void addReference(unsigned long local_time, unsigned long master_time);
+
+    // converts a local time to master time; the local time itself until the first reference
+    unsigned long toMaster(unsigned long local_time);
+
+    bool isSynchronized();
+    long getSkew();
+    // estimated master time - local time at the last reference
+    long getOffset();
+};
+
+#endif /* CLOCKSYNC_h */
@@ -0,0 +1,158 @@
+#include <FrameCodec.h>
+
+static uint32_t zigzag(long value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value < 0 ? -1L : 0L);
+}
+
+static long unzigzag(uint32_t value)
+{
+    return (long)(value >> 1) ^ -(long)(value & 1);
+}
+
+// returns the bytes written, or 0 if it does not fit
+static uint8_t writeVarint(uint32_t value, uint8_t *out, uint8_t capacity)
+{
+    uint8_t size = 0;
+
+    do
+    {
+        if (size >= capacity)
+        {
+            return 0;
+        }
+
+        uint8_t next = value & 0x7F;
+        value >>= 7;
+        out[size++] = next | (value ? 0x80 : 0x00);
+    } while (value);
+
+    return size;
+}
+
+// returns the bytes read, or 0 if the varint is incomplete
+static uint8_t readVarint(const uint8_t *in, int length, uint32_t *value)
+{
+    uint32_t result = 0;
+
+    for (uint8_t i = 0; i < 5 && i < length; i++)
+    {
+        result |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+
+        if (!(in[i] & 0x80))
+        {
+            *value = result;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+FrameEncoder::FrameEncoder(uint8_t _keyframe_interval)
+{
+    keyframe_interval = _keyframe_interval;
+
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        previous[i] = 0;
+    }
+}
+
+uint8_t FrameEncoder::encode(const long *values, uint8_t *out, uint8_t capacity)
+{
+    bool keyframe = keyframe_requested || since_keyframe >= keyframe_interval;
+    uint8_t size = 1;
+
+    if (capacity < 1)
+    {
+        return 0;
+    }
+
+    out[0] = (sequence & FRAME_CODEC_SEQUENCE) | (keyframe ? FRAME_CODEC_KEYFRAME : 0);
+
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        long value = keyframe ? values[i] : values[i] - previous[i];
+        uint8_t written = writeVarint(zigzag(value), out + size, capacity - size);
+
+        if (written == 0)
+        {
+            return 0;
+        }
+
+        size += written;
+    }
+
+    // Only now the frame is known to fit
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        previous[i] = values[i];
+    }
+
+    sequence++;
+    since_keyframe = keyframe ? 1 : since_keyframe + 1;
+    keyframe_requested = false;
+
+    return size;
+}
+
+void FrameEncoder::requestKeyframe()
+{
+    keyframe_requested = true;
+}
+
+void FrameEncoder::setKeyframeInterval(uint8_t _keyframe_interval)
+{
+    keyframe_interval = _keyframe_interval;
+}
+
+int FrameDecoder::decode(const uint8_t *in, int length, long *values)
+{
+    if (length < 1)
+    {
+        return 0;
+    }
+
+    bool keyframe = in[0] & FRAME_CODEC_KEYFRAME;
+    uint8_t frame_sequence = in[0] & FRAME_CODEC_SEQUENCE;
+    long decoded[FRAME_CODEC_CHANNELS];
+    int size = 1;
+
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        uint32_t value;
+        uint8_t read = readVarint(in + size, length - size, &value);
+
+        if (read == 0)
+        {
+            return 0;
+        }
+
+        decoded[i] = unzigzag(value);
+        size += read;
+    }
+
+    if (!keyframe && (!synchronized || frame_sequence != ((sequence + 1) & FRAME_CODEC_SEQUENCE)))
+    {
+        // A delta from a frame that was never received: waits for the next keyframe
+        synchronized = false;
+        return -1;
+    }
+
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        previous[i] = keyframe ? decoded[i] : previous[i] + decoded[i];
+        values[i] = previous[i];
+    }
+
+    sequence = frame_sequence;
+    synchronized = true;
+
+    return size;
+}
+
+bool FrameDecoder::isSynchronized()
+{
+    return synchronized;
+}
@@ -0,0 +1,58 @@
+#ifndef FRAMECODEC_h
+#define FRAMECODEC_h
+
+#include <stdint.h>
+
+// Compact encoding of six-channel frames, for streaming over I2C and serial.
+//
+// Each frame starts with a header byte: bit 7 set for keyframes, bits 0-6 a sequence number.
+// A keyframe carries the absolute value of every channel and a delta frame the difference from
+// the previous frame, both as zig-zag varints (7 bits per byte, least significant first).
+// Small HX711 deltas take 1 or 2 bytes per channel instead of 4. A keyframe is sent every
+// keyframe_interval frames, so a decoder that lost a frame resynchronizes by itself.
+//
+// Does not depend on Arduino, so the decoder can be built into the host tools.
+
+#define FRAME_CODEC_CHANNELS 6
+#define FRAME_CODEC_KEYFRAME 0x80
+#define FRAME_CODEC_SEQUENCE 0x7F
+// header + 5 bytes per channel for the worst case 32 bit value
+#define FRAME_CODEC_MAX_SIZE (1 + 5 * FRAME_CODEC_CHANNELS)
+
+class FrameEncoder
+{
+private:
+    long previous[FRAME_CODEC_CHANNELS];
+    uint8_t sequence = 0;
+    uint8_t keyframe_interval;
+    uint8_t since_keyframe = 0;
+    bool keyframe_requested = true;
+
+public:
+    FrameEncoder(uint8_t keyframe_interval = 32);
+
+    // encodes values into out; returns the size, or 0 (nothing changed) if it needs more than
+    // capacity bytes
+    uint8_t encode(const long *values, uint8_t *out, uint8_t capacity);
+
+    // the next frame will be a keyframe
+    void requestKeyframe();
+    void setKeyframeInterval(uint8_t keyframe_interval);
+};
+
+class FrameDecoder
+{
+private:
+    long previous[FRAME_CODEC_CHANNELS];
+    uint8_t sequence = 0;
+    bool synchronized = false;
+
+public:
+    // decodes one frame from in; returns the bytes used, 0 if the frame is incomplete, or -1 if
+    // the frame was skipped because a keyframe is needed (lost frame or no reference yet)
+    int decode(const uint8_t *in, int length, long *values);
+
+    bool isSynchronized();
+};
+
+#endif /* FRAMECODEC_h */
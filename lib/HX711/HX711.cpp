@@ -20,7 +20,9 @@ void Bridge::begin(byte dout, byte pd_sck, byte gain)
 	DOUT = dout;
 
 	pinMode(PD_SCK, OUTPUT);
-	pinMode(DOUT, INPUT);
+	// with the pull-up a missing or unplugged chip reads as not ready (stuck high) instead of
+	// a floating input that often reads low and returns garbage conversions
+	pinMode(DOUT, INPUT_PULLUP);
 
 	set_gain(gain);
 }
@@ -30,50 +32,142 @@ bool Bridge::is_ready()
 	return digitalRead(DOUT) == LOW;
 }
 
-void Bridge::set_gain(byte gain)
+byte Bridge::gain_to_pulses(byte gain)
 {
 	switch (gain)
 	{
-	case 128: // channel A, gain factor 128
-		GAIN = 1;
-		break;
 	case 64: // channel A, gain factor 64
-		GAIN = 3;
-		break;
+		return 3;
 	case 32: // channel B, gain factor 32
-		GAIN = 2;
-		break;
+		return 2;
+	default: // channel A, gain factor 128
+		return 1;
+	}
+}
+
+void Bridge::set_gain(byte gain)
+{
+	if (gain == 128 || gain == 64 || gain == 32)
+	{
+		GAIN = gain_to_pulses(gain);
 	}
 
+	// the new gain is selected by the pulses after the next reading, so there is no need to
+	// wait for (and throw away) a conversion here
 	digitalWrite(PD_SCK, LOW);
-	read();
 }
 
-long Bridge::read()
+void Bridge::set_schedule(const byte *gains, const byte *dwells, byte length)
+{
+	if (length > BRIDGE_SCHEDULE_MAX)
+	{
+		length = BRIDGE_SCHEDULE_MAX;
+	}
+
+	for (byte i = 0; i < length; i++)
+	{
+		byte dwell = (dwells != NULL) ? dwells[i] : 1;
+
+		if (dwell < 1)
+		{
+			dwell = 1;
+		}
+		if (dwell > BRIDGE_SCHEDULE_MAX_DWELL)
+		{
+			dwell = BRIDGE_SCHEDULE_MAX_DWELL;
+		}
+
+		SCHEDULE[i] = gain_to_pulses(gains[i]) | (dwell << 2);
+	}
+
+	SCHEDULE_LENGTH = length;
+	SCHEDULE_INDEX = 0;
+	SCHEDULE_COUNT = 0;
+}
+
+bool Bridge::wait_ready(unsigned long timeout)
 {
-	// wait for the chip to become ready
+	// counted in 10 us steps instead of millis(), so the wait is also bounded
+	// when called before init() has started the timers
+	unsigned long steps = timeout * 100;
+
 	while (!is_ready())
 	{
+		if (steps == 0)
+		{
+			HEALTH = BRIDGE_STUCK_HIGH;
+			return false;
+		}
+		steps--;
+
+		delayMicroseconds(10);
 		// Will do nothing on Arduino but prevent resets of ESP8266 (Watchdog Issue)
 		yield();
 	}
 
+	return true;
+}
+
+long Bridge::shift_value()
+{
+	// this reading was converted with the pulses sent after the previous one; after a change of
+	// channel or gain the output needs a few conversions to settle
+	if (CONVERTING != LAST_PULSES)
+	{
+		SETTLED = 0;
+	}
+	if (SETTLED < BRIDGE_SETTLING_CONVERSIONS)
+	{
+		SETTLED++;
+	}
+	LAST_PULSES = CONVERTING;
+
+	// only the settled readings of GAIN tell the health of the bridge; the others, e.g. of a
+	// floating channel B input, must not mark it stale or saturated
+	bool tracked = (LAST_PULSES == GAIN && is_settled());
+
+	// called as soon as DOUT is found low, before the 24 clock pulses
+	if (tracked)
+	{
+		READY_TIME = micros();
+	}
+
 	unsigned long value = 0;
 	uint8_t data[3] = {0};
 	uint8_t filler = 0x00;
 
+	// PD_SCK high for more than 60 us powers the chip down, losing the conversion and the selected
+	// gain, so no interrupt may stretch a clock pulse until the gain pulses are sent
+	noInterrupts();
+
 	// pulse the clock pin 24 times to read the data
 	data[2] = shiftIn(DOUT, PD_SCK, MSBFIRST);
 	data[1] = shiftIn(DOUT, PD_SCK, MSBFIRST);
 	data[0] = shiftIn(DOUT, PD_SCK, MSBFIRST);
 
 	// set the channel and the gain factor for the next reading using the clock pin
-	for (unsigned int i = 0; i < GAIN; i++)
+	byte next = GAIN;
+	if (SCHEDULE_LENGTH > 0)
+	{
+		next = SCHEDULE[SCHEDULE_INDEX] & 0x03;
+
+		// each entry is selected for its dwell before moving to the next one
+		if (++SCHEDULE_COUNT >= (SCHEDULE[SCHEDULE_INDEX] >> 2))
+		{
+			SCHEDULE_COUNT = 0;
+			SCHEDULE_INDEX = (SCHEDULE_INDEX + 1) % SCHEDULE_LENGTH;
+		}
+	}
+	CONVERTING = next;
+
+	for (unsigned int i = 0; i < next; i++)
 	{
 		digitalWrite(PD_SCK, HIGH);
 		digitalWrite(PD_SCK, LOW);
 	}
 
+	interrupts();
+
 	// Replicate the most significant bit to pad out a 32-bit signed integer
 	if (data[2] & 0x80)
 	{
@@ -87,18 +181,109 @@ long Bridge::read()
 	// Construct a 32-bit signed integer
 	value = (static_cast<unsigned long>(filler) << 24 | static_cast<unsigned long>(data[2]) << 16 | static_cast<unsigned long>(data[1]) << 8 | static_cast<unsigned long>(data[0]));
 
-	return static_cast<long>(value);
+	LAST_VALUE = static_cast<long>(value);
+
+	if (tracked)
+	{
+		// the HX711 clips the output at 0x7FFFFF and 0x800000 when the input is out of range
+		if (LAST_VALUE == 0x7FFFFFL || LAST_VALUE == -0x800000L)
+		{
+			HEALTH = BRIDGE_SATURATED;
+		}
+		else
+		{
+			HEALTH = BRIDGE_OK;
+		}
+	}
+
+	return LAST_VALUE;
+}
+
+long Bridge::read()
+{
+	read(LAST_VALUE, TIMEOUT);
+	return LAST_VALUE;
+}
+
+bool Bridge::read(long &value, unsigned long timeout)
+{
+	// readings of other gains (the conversion still running when set_gain() was called, or the
+	// other entries of the schedule) and the ones not settled yet are skipped; a full schedule
+	// cycle after the settling always has a settled one of GAIN
+	unsigned int attempts = 1;
+
+	for (byte i = 0; i < SCHEDULE_LENGTH; i++)
+	{
+		attempts += SCHEDULE[i] >> 2;
+	}
+	attempts += BRIDGE_SETTLING_CONVERSIONS;
+
+	for (unsigned int i = 0; i < attempts; i++)
+	{
+		if (!wait_ready(timeout))
+		{
+			return false;
+		}
+
+		long reading = shift_value();
+
+		if (LAST_PULSES == GAIN && is_settled())
+		{
+			value = reading;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Bridge::update()
+{
+	if (is_ready())
+	{
+		shift_value();
+		return true;
+	}
+
+	// in us, like READY_TIME; once stuck high the state is kept even after micros() wraps
+	unsigned long age = micros() - READY_TIME;
+
+	if (age > TIMEOUT * 1000UL)
+	{
+		HEALTH = BRIDGE_STUCK_HIGH;
+	}
+	else if (age > STALE_TIME * 1000UL && HEALTH != BRIDGE_STUCK_HIGH)
+	{
+		HEALTH = BRIDGE_STALE;
+	}
+
+	return false;
 }
 
 long Bridge::read_average(byte times)
 {
 	long sum = 0;
+	long value;
+	byte count = 0;
+
 	for (byte i = 0; i < times; i++)
 	{
-		sum += read();
+		if (!read(value, TIMEOUT))
+		{
+			break;
+		}
+
+		sum += value;
+		count++;
 		yield();
 	}
-	return sum / times;
+
+	if (count == 0)
+	{
+		return LAST_VALUE;
+	}
+
+	return sum / count;
 }
 
 double Bridge::get_value(byte times)
@@ -111,10 +296,62 @@ float Bridge::get_units(byte times)
 	return get_value(times) / SCALE;
 }
 
-void Bridge::tare(byte times)
+long Bridge::get_last()
+{
+	return LAST_VALUE;
+}
+
+float Bridge::get_last_units()
 {
-	double sum = read_average(times);
-	set_offset(sum);
+	return (LAST_VALUE - OFFSET) / SCALE;
+}
+
+unsigned long Bridge::get_ready_time()
+{
+	return READY_TIME;
+}
+
+byte Bridge::get_last_gain()
+{
+	switch (LAST_PULSES)
+	{
+	case 3:
+		return 64;
+	case 2:
+		return 32;
+	default:
+		return 128;
+	}
+}
+
+byte Bridge::get_last_channel()
+{
+	return (LAST_PULSES == 2) ? BRIDGE_CHANNEL_B : BRIDGE_CHANNEL_A;
+}
+
+bool Bridge::is_settled()
+{
+	return SETTLED >= BRIDGE_SETTLING_CONVERSIONS;
+}
+
+bool Bridge::tare(byte times)
+{
+	long sum = 0;
+	long value;
+
+	for (byte i = 0; i < times; i++)
+	{
+		if (!read(value, TIMEOUT))
+		{
+			return false;
+		}
+
+		sum += value;
+		yield();
+	}
+
+	set_offset(sum / times);
+	return true;
 }
 
 void Bridge::set_scale(float scale)
@@ -137,6 +374,26 @@ long Bridge::get_offset()
 	return OFFSET;
 }
 
+byte Bridge::get_health()
+{
+	return HEALTH;
+}
+
+bool Bridge::is_healthy()
+{
+	return HEALTH == BRIDGE_OK;
+}
+
+void Bridge::set_timeout(unsigned int timeout)
+{
+	TIMEOUT = timeout;
+}
+
+void Bridge::set_stale_time(unsigned int stale_time)
+{
+	STALE_TIME = stale_time;
+}
+
 void Bridge::power_down()
 {
 	digitalWrite(PD_SCK, LOW);
@@ -146,4 +403,10 @@ void Bridge::power_down()
 void Bridge::power_up()
 {
 	digitalWrite(PD_SCK, LOW);
+
+	// the chip resets to channel A, gain 128, and settles again
+	CONVERTING = 1;
+	SETTLED = 0;
+	SCHEDULE_INDEX = 0;
+	SCHEDULE_COUNT = 0;
 }
@@ -7,14 +7,62 @@
 #include "WProgram.h"
 #endif
 
+// health of the channel A input at the configured gain: set by each settled reading at that gain,
+// and by update()/wait_ready() when no conversion arrives in time. Readings at another gain and
+// the settling conversions after a switch leave it unchanged
+enum BridgeHealth
+{
+	BRIDGE_OK = 0,		   // last conversion arrived in time and is inside the ADC range
+	BRIDGE_STALE = 1,	   // no new conversion for longer than the stale period
+	BRIDGE_STUCK_HIGH = 2, // DOUT never went low within the timeout (unplugged or failed chip)
+	BRIDGE_SATURATED = 3   // last conversion was clipped at +/-2^23
+};
+
+// input of the HX711 a reading was converted from
+enum BridgeChannel
+{
+	BRIDGE_CHANNEL_A = 0, // gain 128 or 64
+	BRIDGE_CHANNEL_B = 1  // gain 32
+};
+
+// longest acquisition schedule accepted by set_schedule()
+#define BRIDGE_SCHEDULE_MAX 4
+// longest dwell, in conversions, of a schedule entry
+#define BRIDGE_SCHEDULE_MAX_DWELL 63
+
+// from the datasheet: after a change of channel or gain the output settles in 4 conversion periods
+// (400 ms at 10 SPS, 50 ms at 80 SPS). Readings before that are not settled, see is_settled()
+#define BRIDGE_SETTLING_CONVERSIONS 4
+
 class Bridge
 {
 private:
-	byte PD_SCK;	 // Power Down and Serial Clock Input Pin
-	byte DOUT;		 // Serial Data Output Pin
-	byte GAIN;		 // amplification factor
-	long OFFSET = 0; // used for tare weight
-	float SCALE = 1; // used to return weight in grams, kg, ounces, whatever
+	byte PD_SCK;					// Power Down and Serial Clock Input Pin
+	byte DOUT;						// Serial Data Output Pin
+	byte GAIN;						// amplification factor, as clock pulses; the one returned by blocking reads
+	byte CONVERTING = 1;			// pulses of the conversion in progress (channel A, 128 after power up)
+	byte LAST_PULSES = 1;			// pulses of the last reading
+	byte SETTLED = BRIDGE_SETTLING_CONVERSIONS; // readings in a row with LAST_PULSES, up to settled
+	byte SCHEDULE[BRIDGE_SCHEDULE_MAX]; // pulses (bits 0-1) and dwell (bits 2-7) of each entry
+	byte SCHEDULE_LENGTH = 0;		// 0 = no schedule, GAIN is always sent
+	byte SCHEDULE_INDEX = 0;		// entry of SCHEDULE being sent
+	byte SCHEDULE_COUNT = 0;		// conversions already selected with that entry
+	long OFFSET = 0;				// used for tare weight
+	float SCALE = 1;				// used to return weight in grams, kg, ounces, whatever
+	byte HEALTH = BRIDGE_OK;		// health of the last read attempt
+	long LAST_VALUE = 0;			// last raw conversion successfully read
+	unsigned long READY_TIME = 0;	// micros() when the last settled reading of GAIN was found ready
+	unsigned int TIMEOUT = 500;		// maximum time, in ms, a read waits for DOUT to go low
+	unsigned int STALE_TIME = 250;	// time, in ms, without conversions before the channel is stale
+
+	// waits at most timeout ms for the chip to become ready
+	bool wait_ready(unsigned long timeout);
+
+	// clocks the 24 data bits out of the chip, which must already be ready
+	long shift_value();
+
+	// clock pulses after a reading that select the gain for the next conversion
+	static byte gain_to_pulses(byte gain);
 
 public:
 	// define clock and data pin, channel, and gain factor
@@ -34,15 +82,40 @@ public:
 	// input PD_SCK should be low. When DOUT goes to low, it indicates data is ready for retrieval.
 	bool is_ready();
 
-	// set the gain factor; takes effect only after a call to read()
+	// set the gain factor; it is selected for the conversion that starts after the next reading
 	// channel A can be set for a 128 or 64 gain; channel B has a fixed 32 gain
 	// depending on the parameter, the channel is also set to either A or B
+	// no dummy read is made: blocking reads skip the conversion still made with the old gain and
+	// the ones that are not settled yet, and update() tags them, see get_last_gain() and
+	// is_settled(). The health only follows the settled readings of this gain
 	void set_gain(byte gain = 128);
 
-	// waits for the chip to be ready and returns a reading
+	// multiplexed acquisition: each gain of the list is selected for dwells[i] conversions
+	// (1..BRIDGE_SCHEDULE_MAX_DWELL, dwells = NULL for 1 each), in turn. Every reading is tagged
+	// with the gain it was converted with (get_last_gain()) and, since the output needs
+	// BRIDGE_SETTLING_CONVERSIONS conversions after each switch, only the last
+	// dwell - BRIDGE_SETTLING_CONVERSIONS + 1 readings of each entry are settled: e.g. gains
+	// {128, 32} with dwells {20, 4} give 17 settled channel A readings and 1 channel B reading
+	// every 24 conversions. The gain set with set_gain() should be in the list with a dwell of at
+	// least BRIDGE_SETTLING_CONVERSIONS, blocking reads wait for it. length 0 goes back to always
+	// selecting that gain
+	void set_schedule(const byte *gains, const byte *dwells, byte length);
+
+	// waits at most TIMEOUT ms for the chip to be ready and returns a reading
+	// on timeout the last good reading is returned and the health is set to BRIDGE_STUCK_HIGH
 	long read();
 
+	// waits for a reading converted with the gain set with set_gain(), at most timeout ms for each
+	// conversion; returns false, leaving value untouched, on timeout
+	bool read(long &value, unsigned long timeout);
+
+	// non-blocking: reads the chip only if a conversion is ready and refreshes the health state
+	// returns true if a new conversion was read, of any gain of the schedule; it is available
+	// through get_last() and get_last_gain()
+	bool update();
+
 	// returns an average reading; times = how many times to read
+	// stops at the first timeout, averaging only the readings already made
 	long read_average(byte times = 10);
 
 	// returns (read_average() - OFFSET), that is the current value without the tare weight; times = how many readings to do
@@ -52,8 +125,29 @@ public:
 	// times = how many readings to do
 	float get_units(byte times = 1);
 
+	// returns the last raw reading, as read by read() or update()
+	long get_last();
+
+	// returns the last reading converted the same way as get_units()
+	float get_last_units();
+
+	// returns micros() when DOUT was found low for the last settled reading of the gain set with
+	// set_gain(); the timestamp of the sample
+	unsigned long get_ready_time();
+
+	// returns the gain (128, 64 or 32) the last reading was converted with
+	byte get_last_gain();
+
+	// returns the BridgeChannel the last reading was converted from
+	byte get_last_channel();
+
+	// true if the last reading was converted at least BRIDGE_SETTLING_CONVERSIONS conversions
+	// after the last change of channel or gain (or power up)
+	bool is_settled();
+
 	// set the OFFSET value for tare weight; times = how many times to read the tare value
-	void tare(byte times = 10);
+	// returns false, keeping the previous OFFSET, if the chip did not answer every reading in time
+	bool tare(byte times = 10);
 
 	// set the SCALE value; this value is used to convert the raw data to "human readable" data (measure units)
 	void set_scale(float scale = 1.f);
@@ -67,6 +161,20 @@ public:
 	// get the current OFFSET
 	long get_offset();
 
+	// returns the BridgeHealth of the channel
+	byte get_health();
+
+	// true if the channel is delivering usable readings
+	bool is_healthy();
+
+	// set the maximum time, in ms, a blocking read waits for the chip
+	void set_timeout(unsigned int timeout);
+
+	// set the time, in ms, without new conversions before update() marks the channel as stale
+	// it should be a few conversion periods: 100 ms at 10 SPS, 12.5 ms at 80 SPS. With a schedule,
+	// it must also cover the other entries and the settling, between two settled readings of GAIN
+	void set_stale_time(unsigned int stale_time);
+
 	// puts the chip into power down mode
 	void power_down();
 
@@ -1,27 +1,48 @@
 #include <MovingMedianFilter.h>
-#include <stdlib.h>
 #include <string.h>
 
+float MovingMedian::ordered_values[MOVING_MEDIAN_MAX_WINDOW];
+
 MovingMedian::MovingMedian(int _windows_size)
 {
-    windows_size = _windows_size;
+    for (int i = 0; i < MOVING_MEDIAN_MAX_WINDOW; i++)
+    {
+        values[i] = 0;
+    }
 
-    middle = (windows_size / 2);
+    setWindowSize(_windows_size);
+}
+
+MovingMedian::~MovingMedian()
+{
+}
 
-    values = (float *)malloc(windows_size * sizeof(float));
-    ordered_values = (float *)malloc(windows_size * sizeof(float));
+void MovingMedian::setWindowSize(int _windows_size)
+{
+    float last = values[(index_position + (windows_size - 1)) % windows_size];
+
+    if (_windows_size < 1)
+    {
+        _windows_size = 1;
+    }
+    if (_windows_size > MOVING_MEDIAN_MAX_WINDOW)
+    {
+        _windows_size = MOVING_MEDIAN_MAX_WINDOW;
+    }
+
+    windows_size = _windows_size;
+    middle = (windows_size / 2);
+    index_position = 0;
 
     for (int i = 0; i < windows_size; i++)
     {
-        values[i] = 0;
-        ordered_values[i] = 0;
+        values[i] = last;
     }
 }
 
-MovingMedian::~MovingMedian()
+int MovingMedian::getWindowSize()
 {
-    free(values);
-    free(ordered_values);
+    return windows_size;
 }
 
 void MovingMedian::addValue(float value)
@@ -1,13 +1,18 @@
 #ifndef MOVINGMEDIANFILTER_h
 #define MOVINGMEDIANFILTER_h
 
+// Largest window accepted. The storage is static, so the window can be changed at runtime
+// without using the heap
+#define MOVING_MEDIAN_MAX_WINDOW 5
+
 class MovingMedian
 {
 private:
     int windows_size = 3;
     int middle;
-    float *values;
-    float *ordered_values;
+    float values[MOVING_MEDIAN_MAX_WINDOW];
+    // only used while computing the median, so it is shared by all filters
+    static float ordered_values[MOVING_MEDIAN_MAX_WINDOW];
 
     int index_position = 0;
 
@@ -18,6 +23,11 @@ public:
     MovingMedian(int windows_size);
     virtual ~MovingMedian();
 
+    // changes the window, limited to 1..MOVING_MEDIAN_MAX_WINDOW. The window is refilled with the
+    // last value, so the output does not jump
+    void setWindowSize(int windows_size);
+    int getWindowSize();
+
     void addValue(float value);
     float getRawValue();
     float getFiltered();
@@ -0,0 +1,134 @@
+#include <RunningStatistics.h>
+#include <math.h>
+#include <stdlib.h>
+
+// Beyond this the reference is moved to the mean, keeping sum inside a long
+#define RECENTER_LIMIT 0x40000000L
+
+void RunningStatistics::reset()
+{
+    count = 0;
+    reference = 0;
+    sum = 0;
+    sum_squares = 0;
+    minimum = 0;
+    maximum = 0;
+    peak_time = 0;
+}
+
+void RunningStatistics::addValue(long value, unsigned long time)
+{
+    if (count == 0)
+    {
+        reference = value;
+        minimum = value;
+        maximum = value;
+        peak_time = time;
+    }
+
+    long peak = getPeak();
+    if (labs(value) > labs(peak))
+    {
+        peak_time = time;
+    }
+
+    if (value < minimum)
+    {
+        minimum = value;
+    }
+    if (value > maximum)
+    {
+        maximum = value;
+    }
+
+    long deviation = value - reference;
+
+    count++;
+    sum += deviation;
+    sum_squares += (int64_t)deviation * deviation;
+
+    if (sum > RECENTER_LIMIT || sum < -RECENTER_LIMIT)
+    {
+        recenter();
+    }
+}
+
+void RunningStatistics::recenter()
+{
+    // Moving the reference by k: sum' = sum - n k, sum_squares' = sum_squares - 2 k sum + n k^2
+    int64_t n = count;
+    int64_t k = sum / (long)count;
+
+    sum_squares = sum_squares - 2 * k * sum + n * k * k;
+    sum = sum - n * k;
+    reference += k;
+}
+
+unsigned long RunningStatistics::getCount()
+{
+    return count;
+}
+
+long RunningStatistics::getMin()
+{
+    return minimum;
+}
+
+long RunningStatistics::getMax()
+{
+    return maximum;
+}
+
+long RunningStatistics::getPeak()
+{
+    return (labs(maximum) >= labs(minimum)) ? maximum : minimum;
+}
+
+unsigned long RunningStatistics::getPeakTime()
+{
+    return peak_time;
+}
+
+long RunningStatistics::getMean()
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // rounded to the nearest integer
+    long half = (sum >= 0) ? (long)(count / 2) : -(long)(count / 2);
+    return reference + (sum + half) / (long)count;
+}
+
+int64_t RunningStatistics::variance()
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int64_t n = count;
+    int64_t result = (sum_squares - ((int64_t)sum * sum) / n) / n;
+
+    return (result < 0) ? 0 : result;
+}
+
+unsigned long RunningStatistics::getVariance()
+{
+    int64_t result = variance();
+
+    if (result > 0xFFFFFFFFLL)
+    {
+        return 0xFFFFFFFFUL;
+    }
+
+    return (unsigned long)result;
+}
+
+long RunningStatistics::getRms()
+{
+    float mean = getMean();
+
+    return (long)sqrt(mean * mean + (float)variance());
+}
@@ -0,0 +1,41 @@
+#ifndef RUNNINGSTATISTICS_h
+#define RUNNINGSTATISTICS_h
+
+#include <stdint.h>
+
+// Incremental statistics of one channel: min, max, mean, variance/RMS and peak timestamp.
+//
+// Samples are accumulated as exact integer sums of (value - reference). When the sum grows
+// too large the reference is moved to the current mean and the sums are corrected exactly,
+// which is Welford's update done lazily: O(1) per sample, no division and no rounding drift.
+class RunningStatistics
+{
+private:
+    unsigned long count = 0;
+    long reference = 0;       // shift subtracted from every sample
+    long sum = 0;             // sum of (value - reference)
+    int64_t sum_squares = 0;  // sum of (value - reference)^2
+    long minimum = 0;
+    long maximum = 0;
+    unsigned long peak_time = 0;
+
+    void recenter();
+    int64_t variance();
+
+public:
+    void reset();
+    void addValue(long value, unsigned long time);
+
+    unsigned long getCount();
+    long getMin();
+    long getMax();
+    // value with the largest magnitude, and the time it was added
+    long getPeak();
+    unsigned long getPeakTime();
+    long getMean();
+    // saturates at 2^32 - 1
+    unsigned long getVariance();
+    long getRms();
+};
+
+#endif /* RUNNINGSTATISTICS_h */
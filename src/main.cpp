@@ -13,9 +13,14 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <EEPROM.h>
 
 #include <HX711.h>
 #include <MovingMedianFilter.h>
+#include <RunningStatistics.h>
+#include <CaptureBuffer.h>
+#include <FrameCodec.h>
+#include <ClockSync.h>
 
 // --------------------------------------------------------------------------------------------- //
 //  Informações I2C
@@ -27,12 +32,23 @@
 #define DISPOSITIVO_INICIALIZANDO 0xFD
 #define DISPOSITIVO_OCUPADO 0xFE
 #define REQUISICAO_NAO_ENCONTRADA 0xFF
+// Requisição conhecida, mas sem dados para enviar (ex.: canal inválido, captura não concluída).
+// É consumida
+#define REQUISICAO_INDISPONIVEL 0xFC
 
 // Valor da requisição. Usado para o master pedir informações específicas via I2C
 uint8_t requisicao;
 
+// Bytes enviados pelo master depois do código (ex.: registradores da configuração). Reescritos a
+// cada transmissão, inclusive pelos comandos sem resposta, então só valem dentro de quandoReceber
+#define TAMANHO_PARAMETROS 8
+uint8_t parametros[TAMANHO_PARAMETROS];
+uint8_t quantidade_parametros;
+
 // --------------------------------------------------------------------------------------------- //
-// Se usar em modo debug, setar como true
+// Se usar em modo debug, setar como true. Com true o suporte é compilado, e o debug e o buzzer
+// podem ser ligados e desligados em tempo de execução (registradores CONFIG_DEBUG e
+// CONFIG_BUZZER). Esses valores também são os padrões dos registradores
 #define DEBUG true
 #define BUZZER true
 
@@ -42,6 +58,11 @@ uint8_t requisicao;
 unsigned long ultima_leitura_serial;
 #endif
 
+// Modos do debug (registrador CONFIG_DEBUG)
+#define DEBUG_DESLIGADO 0
+#define DEBUG_TEXTO 1   // forças em CSV e mensagens, para acompanhar pelo monitor serial
+#define DEBUG_QUADROS 2 // todos os quadros brutos, codificados (FrameCodec), em pacotes binários
+
 #if BUZZER
 #define BUZZER_PIN 13
 #endif
@@ -75,6 +96,24 @@ bool is_slave_ocupado;
 // Todos os HX711 possuem o mesmo SCK, que é o pino digital 9
 #define BRIDGE_SCK 9
 
+// Ganho padrão dos HX711 (registrador CONFIG_GANHO): 128 ou 64. As pontes estão ligadas no canal
+// A; o ganho 32 seleciona o canal B, que não tem ponte, e por isso não é aceito
+#define GANHO_PONTES 128
+// Intercalação do canal B (sinal auxiliar, ex.: temperatura) com o canal A (forças). Padrão do
+// registrador CONFIG_CANAL_B: 0 = desligada; N = conversões no canal A entre duas passagens pelo
+// canal B, de BRIDGE_SETTLING_CONVERSIONS até BRIDGE_SCHEDULE_MAX_DWELL.
+//
+// Depois de cada troca de canal o HX711 precisa de BRIDGE_SETTLING_CONVERSIONS conversões para
+// acomodar, e as leituras antes disso são ignoradas. Por isso o canal B fica
+// BRIDGE_SETTLING_CONVERSIONS conversões, para uma leitura válida, e das N conversões do canal A
+// só N - BRIDGE_SETTLING_CONVERSIONS + 1 são usadas. Ex.: N = 20, em 10 SPS: 17 leituras de força
+// e uma do canal B a cada 2,4 s
+#define CANAL_B_INTERCALADO 0
+
+// Período de conversão do HX711 no pior caso, 10 SPS, em ms. Usado para validar os tempos das
+// pontes com o canal B intercalado
+#define PERIODO_CONVERSAO_PONTE 100
+
 // Declaração de cada ponte em cada elemento elástico
 Bridge pontes[6] = {
     Bridge(8, BRIDGE_SCK), Bridge(7, BRIDGE_SCK),  // Pontes 1 & 2
@@ -83,6 +122,22 @@ Bridge pontes[6] = {
 
 #define DISTANCIA_SG 6 // 6 mm do ponto O até o centro do strain gauge
 
+// Tempo máximo, em ms, que uma leitura bloqueante (tara) espera o HX711 ficar pronto. Com isso,
+// um HX711 desconectado ou com defeito não trava mais a inicialização nem o laço principal
+#define TIMEOUT_PONTE 500
+// Tempo, em ms, sem novas conversões até a ponte ser considerada desatualizada. Deve ser de
+// alguns periodos de conversão do HX711 (100 ms em 10 SPS)
+#define TEMPO_PONTE_DESATUALIZADA 250
+
+// Últimas leituras brutas de cada ponte, no ganho configurado (canal A) e no canal B. Com o
+// canal B intercalado, a última leitura do HX711 pode ser de qualquer um dos dois
+long leituras_pontes[6];
+long leituras_auxiliares_pontes[6];
+
+// Estado de saúde de cada ponte, 2 bits por ponte (BridgeHealth), enviado para o master.
+// Com alguma ponte com falha o dispositivo continua operando, em modo degradado, com as demais
+uint16_t saude_pontes;
+
 // Temporario. Essas escalas devem ser calibradas periodicamente com um peso de referência
 float coef_proporcao[6] = {
     208219.81, 226134.46,
@@ -92,7 +147,8 @@ float coef_proporcao[6] = {
 #define GRAVIDADE 9.81                            // metros / s^2
 const float PESO_REFERENCIA = 0.1851 * GRAVIDADE; //quilogramas
 
-// Tamanho da janela que irá ser utilizada para filtrar os dados pela mediana
+// Tamanho padrão da janela que irá ser utilizada para filtrar os dados pela mediana
+// (registrador CONFIG_TAMANHO_JANELA, até MOVING_MEDIAN_MAX_WINDOW)
 #define WINDOWS_SIZE 3
 
 // Forcas aferidas por cada ponte
@@ -102,17 +158,176 @@ MovingMedian forcas_pontes[6] = {
     MovingMedian(WINDOWS_SIZE), MovingMedian(WINDOWS_SIZE)};
 
 // Separação dos objetos, para ficar mais intuivo no calculo das resultantes
-MovingMedian *forcas_pontes_a = (&forcas_pontes[0]);
-MovingMedian *forcas_pontes_b = (&forcas_pontes[2]);
-MovingMedian *forcas_pontes_c = (&forcas_pontes[4]);
+// Constantes, para não ocuparem SRAM
+MovingMedian *const forcas_pontes_a = (&forcas_pontes[0]);
+MovingMedian *const forcas_pontes_b = (&forcas_pontes[2]);
+MovingMedian *const forcas_pontes_c = (&forcas_pontes[4]);
 
 // Valores das resultantes encontradas a cada interação
 float forca_x, forca_y, forca_z;
 float momento_roll, momento_pitch, momento_yaw;
 
-// Devem ser calculadas em 20 Hz
+// Devem ser calculadas em 20 Hz (período padrão, em ms, do registrador CONFIG_PERIODO_RESULTANTES)
+#define PERIODO_RESULTANTES 50
 unsigned long ultimo_calculo_resultantes;
 
+// Período padrão, em ms, do envio do debug pela serial (registrador CONFIG_PERIODO_DEBUG)
+#define PERIODO_DEBUG 100
+
+// --------------------------------------------------------------------------------------------- //
+// Estatísticas de cada canal, atualizadas a cada nova amostra, para que o master não precise
+// fazer requisições em alta frequência para encontrar os picos e o RMS.
+//
+// Canais 0 a 5: Fx, Fy, Fz, momento pitch, momento roll e momento yaw (mesma ordem das
+// requisições 0x05 e 0x06). Canais 6 a 11: pontes 1 a 6. Valores em milésimos, como no I2C
+#define ESTATISTICAS_CANAIS 12
+#define ESTATISTICAS_CANAL_PONTES 6
+
+// Um só banco, para caber na SRAM, e o master escolhe a janela: a requisição 0x08 lê e zera o
+// canal (estatísticas desde a última leitura, então mesmo um master lento recebe os extremos
+// exatos do intervalo) e a 0x09 lê sem zerar (desde o último 0x08 ou reset 0x0A)
+RunningStatistics estatisticas[ESTATISTICAS_CANAIS];
+
+// Resposta das requisições 0x08 e 0x09, calculada no laço principal, pois as divisões de 64 bits
+// e a raiz quadrada são longas demais para a interrupção do I2C
+#define ESTATISTICAS_RESPOSTA 7
+long resposta_estatisticas[ESTATISTICAS_RESPOSTA];
+bool is_resposta_estatisticas_pronta;
+
+// Canal pedido pela última requisição 0x08/0x09. Separado dos parâmetros, para um comando (ex.:
+// sincronização pelo general call) entre a escrita e a leitura do master não mudar o pedido
+#define ESTATISTICAS_CANAL_INVALIDO 0xFF
+uint8_t canal_estatisticas = ESTATISTICAS_CANAL_INVALIDO;
+
+// O reset é pedido pelo master na interrupção do I2C e executado no laço principal
+bool is_reset_estatisticas_pendente;
+
+// --------------------------------------------------------------------------------------------- //
+// Captura por gatilho: guarda os quadros brutos das 6 pontes antes e depois de um evento
+// (impacto, colisão), na taxa máxima do HX711, para o master baixar depois.
+//
+// Cada quadro ocupa 13 Bytes (deltas de 16 bits com um expoente comum), então 12 quadros usam 156
+// Bytes de SRAM. Até CAPTURE_MAX_FRAMES
+#define CAPTURA_QUADROS 12
+CaptureBuffer captura(CAPTURA_QUADROS);
+
+// Um quadro é fechado quando todas as pontes ativas entregaram uma nova conversão. Pontes sem
+// resposta não são esperadas, para a captura continuar em modo degradado
+byte pontes_no_quadro;
+
+// Modos do gatilho. O limiar é comparado com o canal (mesma numeração das estatísticas), em
+// milésimos
+#define GATILHO_ACIMA 0      // valor >= limiar
+#define GATILHO_ABAIXO 1     // valor <= limiar
+#define GATILHO_MODULO 2     // |valor| >= limiar
+#define GATILHO_INCLINACAO 3 // |valor - valor anterior| >= limiar
+#define GATILHO_DESARMAR 0xFF
+
+uint8_t gatilho_modo;
+uint8_t gatilho_canal;
+long gatilho_limiar;
+long gatilho_valor_anterior;
+bool gatilho_possui_anterior;
+// A amostra que disparou o gatilho pertence ao quadro em andamento, que só é marcado quando fechado
+bool is_gatilho_disparado;
+
+// --------------------------------------------------------------------------------------------- //
+// Quadros codificados (FrameCodec): deltas em varint com keyframes periódicos. Com deltas
+// pequenos cada quadro usa ~10 Bytes em vez de 24, então o master lê mais quadros por segundo
+// de barramento. O decodificador está na mesma biblioteca, que não depende do Arduino
+#define INTERVALO_KEYFRAME 32
+
+// Último quadro completo, com os valores brutos das pontes
+long quadro_atual[6];
+// Tempo do último quadro completo, em µs no relógio do master
+unsigned long tempo_quadro_atual;
+// micros() em que a primeira ponte do quadro em andamento ficou pronta (DOUT em nível baixo)
+unsigned long inicio_quadro;
+
+// Cada fluxo tem seu codificador, pois o delta é sempre em relação ao último quadro enviado
+FrameEncoder codificador_stream(INTERVALO_KEYFRAME);
+FrameEncoder codificador_captura(INTERVALO_KEYFRAME);
+
+// Quadro da captura lido, mas que não coube na última resposta
+long quadro_captura_pendente[6];
+bool possui_quadro_captura_pendente;
+
+#if DEBUG
+// Pacotes binários na serial (modo DEBUG_QUADROS): sincronismo, tipo, tamanho dos dados e dados.
+// Em CSV cada linha tem ~120 Bytes só das forças. Codificado, cada quadro bruto usa ~17 Bytes com o
+// tempo, então a serial acompanha a taxa máxima do HX711. O decodificador confere cada pacote e, se
+// ele não decodificar, procura o próximo sincronismo
+#define SERIAL_SINCRONISMO 0xA5
+#define SERIAL_PACOTE_QUADRO 0         // tempo do quadro (4 Bytes) + quadro codificado
+#define SERIAL_PACOTE_CAPTURA 1        // índice do quadro do gatilho (1 Byte) + tempo (4 Bytes)
+#define SERIAL_PACOTE_QUADRO_CAPTURA 2 // um quadro codificado da captura. Sem dados: fim
+
+FrameEncoder codificador_serial(INTERVALO_KEYFRAME);
+#endif
+
+// --------------------------------------------------------------------------------------------- //
+// Configuração em tempo de execução
+//
+// Registradores de 16 bits escritos pelo master via I2C, para ajustar o dispositivo a cada
+// bancada sem regravar o firmware. Os padrões são os #define acima. As escritas vão para uma
+// cópia pendente, que só é aplicada, toda de uma vez e entre dois quadros, quando o master
+// confirma. A configuração aplicada pode ser salva na EEPROM e é carregada na inicialização
+#define CONFIG_TAMANHO_JANELA 0
+#define CONFIG_FILTRO 1 // 0 = sem filtro, 1 = mediana
+#define CONFIG_PERIODO_RESULTANTES 2
+#define CONFIG_PERIODO_DEBUG 3
+#define CONFIG_DEBUG 4
+#define CONFIG_BUZZER 5
+#define CONFIG_GANHO 6
+#define CONFIG_TIMEOUT_PONTE 7
+#define CONFIG_TEMPO_PONTE_DESATUALIZADA 8
+#define CONFIG_INTERVALO_KEYFRAME 9
+#define CONFIG_CANAL_B 10
+#define CONFIG_REGISTRADORES 11
+
+#define FILTRO_NENHUM 0
+#define FILTRO_MEDIANA 1
+
+// Na memória de programa, para não ocupar SRAM. Lida com memcpy_P
+const uint16_t configuracao_padrao[CONFIG_REGISTRADORES] PROGMEM = {
+    WINDOWS_SIZE, FILTRO_MEDIANA, PERIODO_RESULTANTES, PERIODO_DEBUG, DEBUG, BUZZER,
+    GANHO_PONTES, TIMEOUT_PONTE, TEMPO_PONTE_DESATUALIZADA, INTERVALO_KEYFRAME,
+    CANAL_B_INTERCALADO};
+
+uint16_t configuracao[CONFIG_REGISTRADORES];
+uint16_t configuracao_pendente[CONFIG_REGISTRADORES];
+
+bool is_aplicar_configuracao_pendente;
+bool is_salvar_configuracao_pendente;
+
+// Layout na EEPROM: assinatura, versão, registradores e checksum
+#define EEPROM_CONFIG_ENDERECO 0
+#define EEPROM_CONFIG_ASSINATURA 0xCA
+#define EEPROM_CONFIG_VERSAO 3
+
+// --------------------------------------------------------------------------------------------- //
+// Sincronização com o relógio do master
+//
+// O master transmite o seu tempo (em µs) pelo general call do I2C, para todos os dispositivos de
+// uma vez. Com esses pares (micros(), tempo do master) são estimados o offset e o desvio (ppm)
+// do relógio local, e cada quadro é marcado no momento em que o HX711 ficou pronto, já no
+// tempo do master. Assim as células de carga podem ser alinhadas entre si e com outros sensores.
+// A leitura de uma ponte atrasa a interrupção do I2C em até ~0,3 ms, então o offset é filtrado
+// pelas referências que chegaram com menos atraso (precisão em ClockSync.h)
+ClockSync sincronizacao;
+
+// Par recebido na interrupção do I2C, processado no laço principal
+unsigned long sincronizacao_local_pendente;
+unsigned long sincronizacao_master_pendente;
+bool is_sincronizacao_pendente;
+
+// Configuração recebida pelo I2C, aplicada no laço principal
+uint8_t gatilho_modo_pendente;
+uint8_t gatilho_canal_pendente;
+long gatilho_limiar_pendente;
+uint8_t captura_quadros_pos_pendente;
+bool is_armar_captura_pendente;
+
 // --------------------------------------------------------------------------------------------- //
 //
 // Definição das funções. São implementadas no fim do arquivo.
@@ -135,6 +350,20 @@ void inicializaBuzzer();
 // Rotina que ficará sendo executada no código
 void rotina();
 
+// --------------------------------------------------------------------------------------------- //
+// Configuração
+// Carrega a configuração da EEPROM, ou os padrões se não houver uma válida
+void carregaConfiguracao();
+// Salva a configuração aplicada na EEPROM
+void salvaConfiguracao();
+// Aplica a configuração pendente, se for válida
+void aplicaConfiguracao();
+bool configuracaoValida(const uint16_t *registradores);
+// Repassa a configuração para os filtros, pontes e codificadores
+void configuraPipeline();
+// Seta o ganho (e a intercalação do canal B) de todas as pontes, e as escalas correspondentes
+void configuraGanhoPontes();
+
 // --------------------------------------------------------------------------------------------- //
 // Pontes de Wheatstone
 // Calcula os coefientes de proporcionalidade de cada ponte
@@ -146,8 +375,33 @@ void setOffSetsPontes();
 float filtraValorPonte(float valor_anterior, float valor_atual, float alpha);
 // Recupera todas as forças aferidas pelas pontes
 void getForcasPontes();
+// Força da ponte na saída do filtro configurado
+float getForcaFiltradaPonte(int ponte);
 // Calcula as forças resultantes de cada componente
 void calculaResultantes();
+// Atualiza os bits de saúde das pontes
+void atualizaSaudePontes();
+// Adiciona uma nova amostra de um canal às estatísticas e ao gatilho da captura. tempo_local é o
+// micros() da amostra
+void processaAmostraCanal(int canal, float valor, unsigned long tempo_local);
+// Chamada quando todas as pontes ativas entregaram uma nova conversão
+void processaQuadro();
+// Dispara a captura se a amostra do canal atender a condição do gatilho
+void verificaGatilho(int canal, long valor);
+// Arma (ou desarma) a captura com a configuração recebida do master
+void armaCaptura();
+#if DEBUG
+// Envia a captura pela serial, em CSV ou em pacotes binários, conforme o modo do debug
+void enviaCapturaSerial();
+// Envia o último quadro completo pela serial, em um pacote binário
+void enviaQuadroSerial();
+// Envia um pacote binário pela serial
+void escreverPacoteSerial(uint8_t tipo, const uint8_t *dados, uint8_t tamanho);
+#endif
+// Zera as estatísticas acumuladas desde o último reset
+void resetaEstatisticas();
+// Calcula a resposta da requisição de estatísticas pendente (0x08 ou 0x09)
+void preparaRespostaEstatisticas();
 
 // --------------------------------------------------------------------------------------------- //
 // I2C
@@ -164,6 +418,16 @@ bool possuiRequisicaoPendente();
 // (int, float, double, long, etc), é necessário enviar um byte de cada vez.
 // long possue 4 bytes no ATmega328
 void escreverQuatroBytesWire(long longParaEnviar);
+// Envia os 3 Bytes menos significativos (valores brutos de 24 bits do HX711)
+void escreverTresBytesWire(long longParaEnviar);
+// Lê um long enviado pelo master nos parâmetros, a partir da posição inicio
+long lerQuatroBytesParametros(uint8_t inicio);
+// Envia o máximo de quadros codificados da captura que couber no buffer do Wire
+void escreverCapturaCodificadaWire();
+// Reinicia o download da captura no primeiro quadro
+void reiniciaDownloadCaptura();
+// Processa a referência de tempo recebida do master
+void sincronizaRelogio();
 
 // --------------------------------------------------------------------------------------------- //
 void alertaSonoro(int qnt_alertas);
@@ -200,6 +464,10 @@ void inicializacao()
   // Função init do Arduino
   init();
 
+  // Configuração salva na EEPROM, antes de tudo que depende dela
+  carregaConfiguracao();
+  configuraPipeline();
+
   // Inicializa o debug, se for setado true
 #if DEBUG
   inicializaDebug();
@@ -229,6 +497,22 @@ void inicializacao()
 // --------------------------------------------------------------------------------------------- //
 void rotina()
 {
+  // Entre dois quadros: mudanças de configuração são aplicadas aqui, todas de uma vez
+  if (is_aplicar_configuracao_pendente)
+  {
+    aplicaConfiguracao();
+  }
+
+  if (is_salvar_configuracao_pendente)
+  {
+    salvaConfiguracao();
+  }
+
+  if (is_sincronizacao_pendente)
+  {
+    sincronizaRelogio();
+  }
+
   // A cada interação verifica se os HX711 estão com os valores prontos, e realiza a leitura das
   // forças atuando em cada ponte
   getForcasPontes();
@@ -236,9 +520,32 @@ void rotina()
   // Com as forças lidas, calcula as resultantes
   calculaResultantes();
 
+  if (is_reset_estatisticas_pendente)
+  {
+    resetaEstatisticas();
+  }
+
+  if ((requisicao == 0x08 || requisicao == 0x09) && !is_resposta_estatisticas_pronta)
+  {
+    preparaRespostaEstatisticas();
+  }
+
+  if (is_armar_captura_pendente)
+  {
+    armaCaptura();
+  }
+
 #if DEBUG
+  // 'C' na serial envia a captura concluída
+  if (myDebug.available() && myDebug.read() == 'C')
+  {
+    enviaCapturaSerial();
+  }
+
   // Debug qualquer informação aqui
-  if ((millis() - ultima_leitura_serial > 100) && !possuiRequisicaoPendente())
+  if (configuracao[CONFIG_DEBUG] == DEBUG_TEXTO &&
+      (millis() - ultima_leitura_serial > configuracao[CONFIG_PERIODO_DEBUG]) &&
+      !possuiRequisicaoPendente())
   {
     ultima_leitura_serial = millis();
 
@@ -246,10 +553,10 @@ void rotina()
 
     for (int i = 0; i < 6; i++)
     {
-      Serial.print(";");
+      Serial.print(';');
       Serial.print(forcas_pontes[i].getRawValue(), 4);
-      Serial.print(";");
-      Serial.print(forcas_pontes[i].getFiltered(), 4);
+      Serial.print(';');
+      Serial.print(getForcaFiltradaPonte(i), 4);
     }
 
     Serial.println();
@@ -262,16 +569,16 @@ void rotina()
 
 void inicializaPontes()
 {
-  // Em cada inicialização, o sistema deve calcular o offset de cada ponte
-  setOffSetsPontes();
   // TODO: temporario. As pontes devem ser calibradas periodicamente
   // calibraCoeficientesProporcionalidade();
-  // Apos calibração, seta os coeficientes de cada ponte
-  setCoeficientesProporcionalidade();
+  // Seta o ganho configurado e, com ele, os coeficientes de cada ponte
+  configuraGanhoPontes();
+  // Em cada inicialização, o sistema deve calcular o offset de cada ponte
+  setOffSetsPontes();
 
   // Faz leituras iniciais para inciar a janela de valores
   // do filtro
-  for (int i = 0; i < WINDOWS_SIZE; i++)
+  for (int i = 0; i < configuracao[CONFIG_TAMANHO_JANELA]; i++)
   {
     getForcasPontes();
 
@@ -285,12 +592,15 @@ void inicializaI2C()
   Wire.begin(SLAVE_ADDRESS);
   Wire.onReceive(quandoReceber);
   Wire.onRequest(quandoRequisitado);
+
+  // Também responde ao general call (endereço 0), usado para a sincronização dos relógios
+  TWAR |= 1;
 }
 
 void inicializaDebug()
 {
   myDebug.begin(BAUDRATE);
-  myDebug.println("time;q_1;q_1f;q_2;q_2f;q_3;q_3f;q_4;q_4f;q_5;q_5f;q_6;q_6f");
+  myDebug.println(F("time;q_1;q_1f;q_2;q_2f;q_3;q_3f;q_4;q_4f;q_5;q_5f;q_6;q_6f"));
 }
 
 void inicializaBuzzer()
@@ -331,9 +641,12 @@ void calibraCoeficientesProporcionalidade()
 
 void setCoeficientesProporcionalidade()
 {
+  // Os coeficientes foram calibrados com ganho 128, e a escala é proporcional ao ganho
+  float fator_ganho = configuracao[CONFIG_GANHO] / 128.0;
+
   for (int i = 0; i < 6; i++)
   {
-    pontes[i].set_scale(coef_proporcao[i]);
+    pontes[i].set_scale(coef_proporcao[i] * fator_ganho);
   }
 }
 
@@ -341,24 +654,133 @@ void setOffSetsPontes()
 {
   for (int i = 0; i < 6; i++)
   {
-    pontes[i].tare();
+    // Se a ponte não responder, mantém o offset anterior e segue com as demais. A falha fica
+    // registrada na saúde da ponte
+    if (!pontes[i].tare())
+    {
+#if DEBUG
+      if (configuracao[CONFIG_DEBUG] == DEBUG_TEXTO)
+      {
+        myDebug.print(F("Ponte sem resposta: "));
+        myDebug.println(i + 1);
+      }
+#endif
+    }
   }
+
+  atualizaSaudePontes();
 }
 
 void getForcasPontes()
 {
+  byte pontes_ativas = 0;
+
   for (int i = 0; i < 6; i++)
   {
-    if (pontes[i].is_ready())
+    // Nunca bloqueia: só lê a ponte se houver conversão pronta. Pontes com falha simplesmente
+    // não alimentam o filtro, e as demais continuam sendo lidas
+    if (pontes[i].update())
     {
-      forcas_pontes[i].addValue(pontes[i].get_units());
+      // Cada leitura vem marcada com o ganho em que foi convertida
+      if (pontes[i].is_settled() && pontes[i].get_last_gain() == configuracao[CONFIG_GANHO])
+      {
+        float forca = pontes[i].get_last_units();
+
+        leituras_pontes[i] = pontes[i].get_last();
+        forcas_pontes[i].addValue(forca);
+        // Sem filtro, para não esconder os transientes
+        processaAmostraCanal(ESTATISTICAS_CANAL_PONTES + i, forca, pontes[i].get_ready_time());
+
+        // O quadro é marcado com o tempo da primeira ponte pronta
+        if (pontes_no_quadro == 0)
+        {
+          inicio_quadro = pontes[i].get_ready_time();
+        }
+        pontes_no_quadro |= (1 << i);
+      }
+      else if (pontes[i].is_settled() && pontes[i].get_last_channel() == BRIDGE_CHANNEL_B)
+      {
+        // Canal B intercalado: sinal auxiliar, fora das forças e dos quadros
+        is_slave_ocupado = true;
+        leituras_auxiliares_pontes[i] = pontes[i].get_last();
+        is_slave_ocupado = false;
+      }
+      // As leituras que ainda não acomodaram depois de uma troca de canal ou ganho (e a que
+      // ainda estava sendo convertida no ganho anterior) são ignoradas
     }
+
+    byte saude = pontes[i].get_health();
+    if (saude == BRIDGE_OK || saude == BRIDGE_SATURATED)
+    {
+      pontes_ativas |= (1 << i);
+    }
+  }
+
+  atualizaSaudePontes();
+
+  if (pontes_ativas != 0 && (pontes_no_quadro & pontes_ativas) == pontes_ativas)
+  {
+    pontes_no_quadro = 0;
+    processaQuadro();
+
+#if DEBUG
+    if (configuracao[CONFIG_DEBUG] == DEBUG_QUADROS)
+    {
+      enviaQuadroSerial();
+    }
+#endif
+  }
+}
+
+void processaQuadro()
+{
+  is_slave_ocupado = true;
+
+  for (int i = 0; i < 6; i++)
+  {
+    quadro_atual[i] = leituras_pontes[i];
+  }
+  tempo_quadro_atual = sincronizacao.toMaster(inicio_quadro);
+
+  captura.addFrame(quadro_atual);
+  if (is_gatilho_disparado)
+  {
+    captura.trigger(tempo_quadro_atual);
+    is_gatilho_disparado = false;
+  }
+
+  is_slave_ocupado = false;
+}
+
+float getForcaFiltradaPonte(int ponte)
+{
+  if (configuracao[CONFIG_FILTRO] == FILTRO_NENHUM)
+  {
+    return (leituras_pontes[ponte] - pontes[ponte].get_offset()) / pontes[ponte].get_scale();
+  }
+
+  return forcas_pontes[ponte].getFiltered();
+}
+
+void atualizaSaudePontes()
+{
+  uint16_t saude = 0;
+
+  for (int i = 0; i < 6; i++)
+  {
+    saude |= (uint16_t)pontes[i].get_health() << (2 * i);
   }
+
+  // Escrita de 16 bits: sem a interrupção no meio, a requisição 0x07 não lê metade de cada valor
+  noInterrupts();
+  saude_pontes = saude;
+  interrupts();
 }
 
 void calculaResultantes()
 {
-  if ((millis() - ultimo_calculo_resultantes > 50) && !possuiRequisicaoPendente())
+  if ((millis() - ultimo_calculo_resultantes > configuracao[CONFIG_PERIODO_RESULTANTES]) &&
+      !possuiRequisicaoPendente())
   {
     ultimo_calculo_resultantes = millis();
     // Trava as requisições aqui, para não ser enviado informações que ainda estão
@@ -369,9 +791,221 @@ void calculaResultantes()
 
     // Libera as requisições
     is_slave_ocupado = false;
+
+    unsigned long agora = micros();
+
+    processaAmostraCanal(0, forca_x, agora);
+    processaAmostraCanal(1, forca_y, agora);
+    processaAmostraCanal(2, forca_z, agora);
+    processaAmostraCanal(3, momento_pitch, agora);
+    processaAmostraCanal(4, momento_roll, agora);
+    processaAmostraCanal(5, momento_yaw, agora);
+  }
+}
+
+void processaAmostraCanal(int canal, float valor, unsigned long tempo_local)
+{
+  long valor_milesimos = (long)(valor * 1000);
+  // O tempo do pico é enviado no relógio do master, em µs
+  unsigned long agora = sincronizacao.toMaster(tempo_local);
+
+  // A interrupção do I2C só lê a resposta já calculada, então não precisa travar as requisições
+  estatisticas[canal].addValue(valor_milesimos, agora);
+
+  verificaGatilho(canal, valor_milesimos);
+}
+
+void verificaGatilho(int canal, long valor)
+{
+  if (captura.getState() != CAPTURE_ARMED || canal != gatilho_canal)
+  {
+    return;
+  }
+
+  bool disparou = false;
+
+  switch (gatilho_modo)
+  {
+  case GATILHO_ACIMA:
+    disparou = (valor >= gatilho_limiar);
+    break;
+  case GATILHO_ABAIXO:
+    disparou = (valor <= gatilho_limiar);
+    break;
+  case GATILHO_MODULO:
+    disparou = (labs(valor) >= gatilho_limiar);
+    break;
+  case GATILHO_INCLINACAO:
+    disparou = gatilho_possui_anterior && (labs(valor - gatilho_valor_anterior) >= gatilho_limiar);
+    break;
+  }
+
+  gatilho_valor_anterior = valor;
+  gatilho_possui_anterior = true;
+
+  if (disparou)
+  {
+    // Marcado em processaQuadro, quando o quadro com a amostra for fechado
+    is_gatilho_disparado = true;
+  }
+}
+
+void armaCaptura()
+{
+  is_slave_ocupado = true;
+
+  gatilho_modo = gatilho_modo_pendente;
+  gatilho_canal = gatilho_canal_pendente;
+  gatilho_limiar = gatilho_limiar_pendente;
+  gatilho_possui_anterior = false;
+  is_gatilho_disparado = false;
+
+  if (gatilho_modo == GATILHO_DESARMAR)
+  {
+    captura.disarm();
+  }
+  else
+  {
+    captura.arm(captura_quadros_pos_pendente);
+  }
+
+  is_armar_captura_pendente = false;
+  is_slave_ocupado = false;
+}
+
+#if DEBUG
+void enviaCapturaSerial()
+{
+  long quadro[6];
+
+  if (configuracao[CONFIG_DEBUG] == DEBUG_QUADROS)
+  {
+    // Pacote de início (índice 0xFF se não concluída), os quadros e um pacote vazio no fim
+    uint8_t dados[FRAME_CODEC_MAX_SIZE];
+    uint8_t tamanho;
+    unsigned long tempo = captura.getTriggerTime();
+
+    dados[0] = captura.isDone() ? captura.getTriggerIndex() : 0xFF;
+    for (int i = 0; i < 4; i++)
+    {
+      dados[1 + i] = tempo >> (24 - 8 * i);
+    }
+    escreverPacoteSerial(SERIAL_PACOTE_CAPTURA, dados, 5);
+
+    // O cursor e o codificador do download por I2C (0x0C, 0x0D, 0x10) são usados pela
+    // interrupção, então a serial lê por índice e usa o seu codificador, que volta para o stream
+    // com um keyframe
+    codificador_serial.requestKeyframe();
+    for (int indice = 0; captura.frameAt(indice, quadro); indice++)
+    {
+      tamanho = codificador_serial.encode(quadro, dados, sizeof(dados));
+      escreverPacoteSerial(SERIAL_PACOTE_QUADRO_CAPTURA, dados, tamanho);
+    }
+    escreverPacoteSerial(SERIAL_PACOTE_QUADRO_CAPTURA, dados, 0);
+
+    codificador_serial.requestKeyframe();
+    return;
+  }
+
+  if (!captura.isDone())
+  {
+    myDebug.println(F("Captura nao concluida"));
+    return;
+  }
+
+  myDebug.print(F("captura;gatilho="));
+  myDebug.print(captura.getTriggerIndex());
+  myDebug.print(F(";tempo="));
+  myDebug.println(captura.getTriggerTime());
+
+  // Lê por índice, sem mexer no download por I2C
+  for (int indice = 0; captura.frameAt(indice, quadro); indice++)
+  {
+    myDebug.print(indice);
+
+    for (int i = 0; i < 6; i++)
+    {
+      myDebug.print(';');
+      myDebug.print(quadro[i]);
+    }
+
+    myDebug.println();
   }
 }
 
+void enviaQuadroSerial()
+{
+  // Tempo do quadro (µs no relógio do master), como na requisição 0x0E, e o quadro codificado
+  uint8_t dados[4 + FRAME_CODEC_MAX_SIZE];
+  uint8_t tamanho;
+
+  for (int i = 0; i < 4; i++)
+  {
+    dados[i] = tempo_quadro_atual >> (24 - 8 * i);
+  }
+  tamanho = codificador_serial.encode(quadro_atual, dados + 4, sizeof(dados) - 4);
+
+  escreverPacoteSerial(SERIAL_PACOTE_QUADRO, dados, 4 + tamanho);
+}
+
+void escreverPacoteSerial(uint8_t tipo, const uint8_t *dados, uint8_t tamanho)
+{
+  myDebug.write(SERIAL_SINCRONISMO);
+  myDebug.write(tipo);
+  myDebug.write(tamanho);
+  myDebug.write(dados, tamanho);
+}
+#endif
+
+void resetaEstatisticas()
+{
+  for (int i = 0; i < ESTATISTICAS_CANAIS; i++)
+  {
+    estatisticas[i].reset();
+  }
+
+  is_reset_estatisticas_pendente = false;
+}
+
+void preparaRespostaEstatisticas()
+{
+  noInterrupts();
+  uint8_t codigo = requisicao;
+  uint8_t canal = canal_estatisticas;
+  interrupts();
+
+  if (canal >= ESTATISTICAS_CANAIS)
+  {
+    // A interrupção responde REQUISICAO_INDISPONIVEL
+    return;
+  }
+
+  RunningStatistics &estatisticas_canal = estatisticas[canal];
+
+  // A interrupção só lê a resposta depois que ela é marcada como pronta
+  resposta_estatisticas[0] = estatisticas_canal.getCount();
+  resposta_estatisticas[1] = estatisticas_canal.getMin();
+  resposta_estatisticas[2] = estatisticas_canal.getMax();
+  resposta_estatisticas[3] = estatisticas_canal.getMean();
+  resposta_estatisticas[4] = estatisticas_canal.getRms();
+  resposta_estatisticas[5] = estatisticas_canal.getPeak();
+  resposta_estatisticas[6] = estatisticas_canal.getPeakTime();
+
+  noInterrupts();
+  // O master pode ter enviado outra requisição durante o cálculo. Nesse caso a resposta é
+  // descartada e o canal não é zerado, para a janela não se perder
+  if (requisicao == codigo && canal_estatisticas == canal)
+  {
+    // Zera junto com a resposta, então nenhuma amostra fica fora das duas janelas
+    if (codigo == 0x08)
+    {
+      estatisticas_canal.reset();
+    }
+    is_resposta_estatisticas_pronta = true;
+  }
+  interrupts();
+}
+
 void quandoRequisitado()
 {
   // Quando as requisições forem executadas com sucesso, ela é consumida depois.
@@ -401,13 +1035,154 @@ void quandoRequisitado()
 
     consumirRequisicao();
   }
+  else if (requisicao == 0x07)
+  {
+    // Requisicao da saúde das pontes: 2 Bytes, 2 bits por ponte (ponte 1 nos bits menos
+    // significativos). 0 = ok, 1 = desatualizada, 2 = sem resposta, 3 = saturada
+    Wire.write(saude_pontes >> 8);
+    Wire.write(saude_pontes & 0xFF);
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x08 || requisicao == 0x09)
+  {
+    // Requisicao das estatísticas de um canal (parametro: canal): 28 Bytes. Quantidade, mínimo,
+    // máximo, média, RMS, pico e tempo do pico
+    // 0x08: desde a última leitura, e zera o canal (leitura atômica)
+    // 0x09: sem zerar, desde o último 0x08 ou reset (comando 0x0A)
+    if (canal_estatisticas >= ESTATISTICAS_CANAIS)
+    {
+      Wire.write(REQUISICAO_INDISPONIVEL);
+
+      consumirRequisicao();
+    }
+    else if (!is_resposta_estatisticas_pronta)
+    { // Ainda sendo calculada no laço principal. Não consome a requisição
+      Wire.write(DISPOSITIVO_OCUPADO);
+    }
+    else
+    {
+      for (int i = 0; i < ESTATISTICAS_RESPOSTA; i++)
+      {
+        escreverQuatroBytesWire(resposta_estatisticas[i]);
+      }
+      is_resposta_estatisticas_pronta = false;
+
+      consumirRequisicao();
+    }
+  }
+  else if (requisicao == 0x0C)
+  {
+    // Requisicao do estado da captura: 8 Bytes. Estado, quadros guardados, índice do quadro do
+    // gatilho, quadros depois dele e tempo do gatilho. Índice e quadros depois do gatilho são
+    // 0xFF enquanto a captura não estiver concluída. Também reinicia o download no primeiro quadro
+    Wire.write(captura.getState());
+    Wire.write(captura.getStored());
+    if (captura.isDone())
+    {
+      Wire.write(captura.getTriggerIndex());
+      Wire.write(captura.getStored() - 1 - captura.getTriggerIndex());
+    }
+    else
+    {
+      Wire.write(0xFF);
+      Wire.write(0xFF);
+    }
+    escreverQuatroBytesWire(captura.getTriggerTime());
+
+    reiniciaDownloadCaptura();
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x0D)
+  {
+    // Requisicao do próximo quadro da captura: 18 Bytes, valores brutos de 24 bits das pontes.
+    // Sem captura concluída, ou depois do último quadro, 1 Byte: REQUISICAO_INDISPONIVEL
+    long quadro[6];
+
+    if (captura.readFrame(quadro))
+    {
+      for (int i = 0; i < 6; i++)
+      {
+        escreverTresBytesWire(quadro[i]);
+      }
+    }
+    else
+    {
+      Wire.write(REQUISICAO_INDISPONIVEL);
+    }
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x22)
+  {
+    // Requisicao da configuração aplicada: 2 Bytes por registrador
+    for (int i = 0; i < CONFIG_REGISTRADORES; i++)
+    {
+      Wire.write(configuracao[i] >> 8);
+      Wire.write(configuracao[i] & 0xFF);
+    }
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x11)
+  {
+    // Requisicao das leituras do canal B (sinal auxiliar): 18 Bytes, valores brutos de 24 bits
+    for (int i = 0; i < 6; i++)
+    {
+      escreverTresBytesWire(leituras_auxiliares_pontes[i]);
+    }
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x0E)
+  {
+    // Requisicao do último quadro: 1 Byte de tamanho, 4 Bytes do tempo do quadro (µs no relógio
+    // do master) e o quadro codificado. Com valores de 24 bits, o quadro tem no máximo 25 Bytes
+    uint8_t codificado[32 - 1 - 4];
+    uint8_t tamanho = codificador_stream.encode(quadro_atual, codificado, sizeof(codificado));
+
+    Wire.write(tamanho);
+    escreverQuatroBytesWire(tempo_quadro_atual);
+    Wire.write(codificado, tamanho);
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x31)
+  {
+    // Requisicao do estado da sincronização: 9 Bytes. Sincronizado, desvio (ppm) e offset (µs)
+    Wire.write(sincronizacao.isSynchronized());
+    escreverQuatroBytesWire(sincronizacao.getSkew());
+    escreverQuatroBytesWire(sincronizacao.getOffset());
+
+    consumirRequisicao();
+  }
+  else if (requisicao == 0x10)
+  {
+    // Requisicao dos próximos quadros da captura, codificados: 1 Byte de tamanho + quadros.
+    // Tamanho 0 indica que a captura terminou. Sem captura concluída, 1 Byte:
+    // REQUISICAO_INDISPONIVEL
+    if (captura.isDone())
+    {
+      escreverCapturaCodificadaWire();
+    }
+    else
+    {
+      Wire.write(REQUISICAO_INDISPONIVEL);
+    }
+
+    consumirRequisicao();
+  }
   else
   {
 
 #if DEBUG
-    myDebug.print(F("Requisicao nao encontrada: "));
-    myDebug.println(requisicao);
-    delay(500);
+    if (configuracao[CONFIG_DEBUG] == DEBUG_TEXTO)
+    {
+      // Sem delay: dentro da interrupção do I2C ele nunca termina
+      myDebug.print(F("Requisicao nao encontrada: "));
+      myDebug.println(requisicao);
+    }
 #endif
     // Requisicao solicitada não foi encontrada
     Wire.write(REQUISICAO_NAO_ENCONTRADA);
@@ -420,13 +1195,104 @@ void quandoRequisitado()
 
 void quandoReceber(int quantitadeBytes)
 {
+  // Marcado antes de tudo, para a referência de tempo ter o menor atraso possível
+  unsigned long recebido = micros();
+
   if (Wire.available())
   {
-    requisicao = Wire.read();
+    uint8_t codigo = Wire.read();
+
+    quantidade_parametros = 0;
+    while (Wire.available() && quantidade_parametros < TAMANHO_PARAMETROS)
+    {
+      parametros[quantidade_parametros++] = Wire.read();
+    }
+
+    // Comandos sem resposta são executados (ou agendados) aqui, e não ficam pendentes
+    if (codigo == 0x0A)
+    {
+      // Reset das estatísticas acumuladas
+      is_reset_estatisticas_pendente = true;
+      return;
+    }
+    else if (codigo == 0x20 && quantidade_parametros >= 3)
+    {
+      // Escreve registradores na configuração pendente: registrador inicial e valores de 16
+      // bits (até 3 por transmissão), nos registradores seguintes
+      for (uint8_t i = 1; i + 1 < quantidade_parametros; i += 2)
+      {
+        uint8_t registrador = parametros[0] + (i - 1) / 2;
+
+        if (registrador < CONFIG_REGISTRADORES)
+        {
+          configuracao_pendente[registrador] = ((uint16_t)parametros[i] << 8) | parametros[i + 1];
+        }
+      }
+      return;
+    }
+    else if (codigo == 0x21)
+    {
+      // Aplica a configuração pendente entre os próximos quadros
+      is_aplicar_configuracao_pendente = true;
+      return;
+    }
+    else if (codigo == 0x23)
+    {
+      // Salva a configuração aplicada na EEPROM
+      is_salvar_configuracao_pendente = true;
+      return;
+    }
+    else if (codigo == 0x24)
+    {
+      // Volta a configuração pendente para os padrões do firmware (ainda precisa do 0x21)
+      memcpy_P(configuracao_pendente, configuracao_padrao, sizeof(configuracao_pendente));
+      return;
+    }
+    else if (codigo == 0x30 && quantidade_parametros >= 4)
+    {
+      // Referência de tempo do master (µs), normalmente pelo general call
+      sincronizacao_local_pendente = recebido;
+      sincronizacao_master_pendente = lerQuatroBytesParametros(0);
+      is_sincronizacao_pendente = true;
+      return;
+    }
+    else if (codigo == 0x0F)
+    {
+      // O master perdeu um quadro do stream: o próximo é keyframe
+      codificador_stream.requestKeyframe();
+      return;
+    }
+    else if (codigo == 0x0B && quantidade_parametros >= 7)
+    {
+      // Arma a captura: modo, canal, limiar (4 Bytes) e quantidade de quadros após o gatilho.
+      // Modo 0xFF desarma
+      gatilho_modo_pendente = parametros[0];
+      gatilho_canal_pendente = parametros[1];
+      gatilho_limiar_pendente = lerQuatroBytesParametros(2);
+      captura_quadros_pos_pendente = parametros[6];
+      is_armar_captura_pendente = true;
+      return;
+    }
+
+    if (codigo == 0x08 || codigo == 0x09)
+    {
+      canal_estatisticas = ESTATISTICAS_CANAL_INVALIDO;
+      if (quantidade_parametros >= 1)
+      {
+        canal_estatisticas = parametros[0];
+      }
+    }
+
+    requisicao = codigo;
+    // Uma resposta de estatísticas já calculada era da requisição anterior
+    is_resposta_estatisticas_pronta = false;
 
 #if DEBUG
-    myDebug.print("Requisicao recebida: ");
-    myDebug.println(requisicao);
+    if (configuracao[CONFIG_DEBUG] == DEBUG_TEXTO)
+    {
+      myDebug.print(F("Requisicao recebida: "));
+      myDebug.println(requisicao);
+    }
 #endif
   }
 }
@@ -464,8 +1330,247 @@ void escreverQuatroBytesWire(long longParaEnviar)
                                              // ---- ---- ---- ---- ---- ---- BBBB BBBB
 }
 
+void escreverTresBytesWire(long longParaEnviar)
+{
+  Wire.write((longParaEnviar >> 16) & 0xFF);
+  Wire.write((longParaEnviar >> 8) & 0xFF);
+  Wire.write((longParaEnviar)&0xFF);
+}
+
+long lerQuatroBytesParametros(uint8_t inicio)
+{
+  return ((long)parametros[inicio] << 24) | ((long)parametros[inicio + 1] << 16) |
+         ((long)parametros[inicio + 2] << 8) | ((long)parametros[inicio + 3]);
+}
+
+void escreverCapturaCodificadaWire()
+{
+  // O buffer do Wire tem 32 Bytes, e o primeiro é o tamanho
+  uint8_t codificado[31];
+  uint8_t tamanho = 0;
+
+  while (true)
+  {
+    if (!possui_quadro_captura_pendente)
+    {
+      if (!captura.readFrame(quadro_captura_pendente))
+      {
+        break;
+      }
+      possui_quadro_captura_pendente = true;
+    }
+
+    uint8_t escritos = codificador_captura.encode(quadro_captura_pendente, codificado + tamanho,
+                                                  sizeof(codificado) - tamanho);
+    if (escritos == 0)
+    {
+      // Não coube, vai na próxima resposta
+      break;
+    }
+
+    tamanho += escritos;
+    possui_quadro_captura_pendente = false;
+  }
+
+  Wire.write(tamanho);
+  Wire.write(codificado, tamanho);
+}
+
+void reiniciaDownloadCaptura()
+{
+  captura.rewind();
+  codificador_captura.requestKeyframe();
+  possui_quadro_captura_pendente = false;
+}
+
+void carregaConfiguracao()
+{
+  uint16_t salva[CONFIG_REGISTRADORES];
+  uint8_t *bytes = (uint8_t *)salva;
+  uint8_t checksum = 0;
+  int endereco = EEPROM_CONFIG_ENDERECO + 2;
+
+  for (unsigned int i = 0; i < sizeof(salva); i++)
+  {
+    bytes[i] = EEPROM.read(endereco++);
+    checksum += bytes[i];
+  }
+
+  if (EEPROM.read(EEPROM_CONFIG_ENDERECO) == EEPROM_CONFIG_ASSINATURA &&
+      EEPROM.read(EEPROM_CONFIG_ENDERECO + 1) == EEPROM_CONFIG_VERSAO &&
+      EEPROM.read(endereco) == checksum && configuracaoValida(salva))
+  {
+    memcpy(configuracao, salva, sizeof(configuracao));
+  }
+  else
+  {
+    memcpy_P(configuracao, configuracao_padrao, sizeof(configuracao));
+  }
+
+  memcpy(configuracao_pendente, configuracao, sizeof(configuracao_pendente));
+}
+
+void salvaConfiguracao()
+{
+  const uint8_t *bytes = (const uint8_t *)configuracao;
+  uint8_t checksum = 0;
+  int endereco = EEPROM_CONFIG_ENDERECO + 2;
+
+  // update só grava os bytes que mudaram, para poupar a EEPROM
+  EEPROM.update(EEPROM_CONFIG_ENDERECO, EEPROM_CONFIG_ASSINATURA);
+  EEPROM.update(EEPROM_CONFIG_ENDERECO + 1, EEPROM_CONFIG_VERSAO);
+
+  for (unsigned int i = 0; i < sizeof(configuracao); i++)
+  {
+    EEPROM.update(endereco++, bytes[i]);
+    checksum += bytes[i];
+  }
+
+  EEPROM.update(endereco, checksum);
+
+  is_salvar_configuracao_pendente = false;
+}
+
+bool configuracaoValida(const uint16_t *registradores)
+{
+  uint16_t ganho = registradores[CONFIG_GANHO];
+
+  return registradores[CONFIG_TAMANHO_JANELA] >= 1 &&
+         registradores[CONFIG_TAMANHO_JANELA] <= MOVING_MEDIAN_MAX_WINDOW &&
+         registradores[CONFIG_FILTRO] <= FILTRO_MEDIANA &&
+         registradores[CONFIG_PERIODO_RESULTANTES] >= 1 &&
+         registradores[CONFIG_PERIODO_DEBUG] >= 1 &&
+         registradores[CONFIG_DEBUG] <= DEBUG_QUADROS &&
+         registradores[CONFIG_BUZZER] <= 1 &&
+         (ganho == 128 || ganho == 64) &&
+         registradores[CONFIG_TEMPO_PONTE_DESATUALIZADA] >= 1 &&
+         registradores[CONFIG_TIMEOUT_PONTE] > registradores[CONFIG_TEMPO_PONTE_DESATUALIZADA] &&
+         registradores[CONFIG_INTERVALO_KEYFRAME] >= 1 &&
+         registradores[CONFIG_INTERVALO_KEYFRAME] <= 255 &&
+         (registradores[CONFIG_CANAL_B] == 0 ||
+          (registradores[CONFIG_CANAL_B] >= BRIDGE_SETTLING_CONVERSIONS &&
+           registradores[CONFIG_CANAL_B] <= BRIDGE_SCHEDULE_MAX_DWELL &&
+           // Entre duas leituras válidas do canal A passam as conversões do canal B e as de
+           // acomodação do canal A. Com uma conversão de folga, a ponte não pode ficar
+           // desatualizada nesse intervalo (250 ms, o padrão, não basta)
+           registradores[CONFIG_TEMPO_PONTE_DESATUALIZADA] >
+               (2 * BRIDGE_SETTLING_CONVERSIONS + 1) * PERIODO_CONVERSAO_PONTE));
+}
+
+void aplicaConfiguracao()
+{
+  uint16_t nova[CONFIG_REGISTRADORES];
+
+  // A configuração pendente é escrita na interrupção do I2C
+  noInterrupts();
+  memcpy(nova, configuracao_pendente, sizeof(nova));
+  is_aplicar_configuracao_pendente = false;
+  interrupts();
+
+  if (!configuracaoValida(nova))
+  {
+    // Descarta tudo: nenhuma parte de uma configuração inválida é aplicada
+    noInterrupts();
+    memcpy(configuracao_pendente, configuracao, sizeof(configuracao_pendente));
+    interrupts();
+
+#if DEBUG
+    if (configuracao[CONFIG_DEBUG] == DEBUG_TEXTO)
+    {
+      myDebug.println(F("Configuracao invalida"));
+    }
+#endif
+    return;
+  }
+
+  uint16_t ganho_anterior = configuracao[CONFIG_GANHO];
+  bool mudou_ganho = (nova[CONFIG_GANHO] != ganho_anterior);
+  bool mudou_canal_b = (nova[CONFIG_CANAL_B] != configuracao[CONFIG_CANAL_B]);
+
+  is_slave_ocupado = true;
+  memcpy(configuracao, nova, sizeof(configuracao));
+  configuraPipeline();
+
+  if (mudou_ganho)
+  {
+    // O offset é proporcional ao ganho, então é reescalado. Refazer a tara mudaria o zero para a
+    // carga atual e bloquearia o laço por ~1 s por ponte
+    for (int i = 0; i < 6; i++)
+    {
+      pontes[i].set_offset(pontes[i].get_offset() * (long)configuracao[CONFIG_GANHO] /
+                           (long)ganho_anterior);
+    }
+  }
+
+  if (mudou_ganho || mudou_canal_b)
+  {
+    configuraGanhoPontes();
+  }
+
+  // O quadro em andamento é descartado, para não misturar leituras de antes e depois da mudança
+  pontes_no_quadro = 0;
+  is_slave_ocupado = false;
+}
+
+void configuraPipeline()
+{
+  for (int i = 0; i < 6; i++)
+  {
+    // Mudar a janela reinicia o filtro, então só é feito se ela mudou
+    if (forcas_pontes[i].getWindowSize() != configuracao[CONFIG_TAMANHO_JANELA])
+    {
+      forcas_pontes[i].setWindowSize(configuracao[CONFIG_TAMANHO_JANELA]);
+    }
+
+    pontes[i].set_timeout(configuracao[CONFIG_TIMEOUT_PONTE]);
+    pontes[i].set_stale_time(configuracao[CONFIG_TEMPO_PONTE_DESATUALIZADA]);
+  }
+
+  codificador_stream.setKeyframeInterval(configuracao[CONFIG_INTERVALO_KEYFRAME]);
+  codificador_captura.setKeyframeInterval(configuracao[CONFIG_INTERVALO_KEYFRAME]);
+#if DEBUG
+  codificador_serial.setKeyframeInterval(configuracao[CONFIG_INTERVALO_KEYFRAME]);
+  // Quem passou a ler a serial agora começa por um keyframe
+  codificador_serial.requestKeyframe();
+#endif
+}
+
+void configuraGanhoPontes()
+{
+  // Com o canal B intercalado, as conversões alternam entre blocos no ganho configurado e no
+  // canal B, este só com as conversões de acomodação
+  byte agenda[2] = {(byte)configuracao[CONFIG_GANHO], 32};
+  byte permanencia[2] = {(byte)configuracao[CONFIG_CANAL_B], BRIDGE_SETTLING_CONVERSIONS};
+
+  for (int i = 0; i < 6; i++)
+  {
+    pontes[i].set_gain(configuracao[CONFIG_GANHO]);
+    pontes[i].set_schedule(agenda, permanencia, configuracao[CONFIG_CANAL_B] ? 2 : 0);
+  }
+
+  setCoeficientesProporcionalidade();
+}
+
+void sincronizaRelogio()
+{
+  noInterrupts();
+  unsigned long local = sincronizacao_local_pendente;
+  unsigned long master = sincronizacao_master_pendente;
+  is_sincronizacao_pendente = false;
+  interrupts();
+
+  is_slave_ocupado = true;
+  sincronizacao.addReference(local, master);
+  is_slave_ocupado = false;
+}
+
 void alertaSonoro(int qnt_alertas)
 {
+  if (!configuracao[CONFIG_BUZZER])
+  {
+    return;
+  }
+
   for (int i = 0; i < qnt_alertas; i++)
   {
     digitalWrite(BUZZER_PIN, HIGH);
@@ -0,0 +1,288 @@
+// Trigger capture and its block floating point storage, run on the host: pio test -e native
+
+#include <unity.h>
+#include <CaptureBuffer.h>
+
+// slowly varying HX711 readings, like a loaded bridge with noise
+static void makeFrame(int index, long *values)
+{
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        values[i] = 100000L * (i - 2) + 37L * index + ((index * (i + 3)) % 11) - 5;
+    }
+}
+
+// deterministic pseudo random numbers, the same on every host
+static unsigned long random_state = 1;
+
+static long randomValue(long minimum, long maximum)
+{
+    random_state = random_state * 1103515245UL + 12345UL;
+    return minimum + (long)((random_state >> 8) % (unsigned long)(maximum - minimum + 1));
+}
+
+// smallest exponent whose rounded mantissa of the delta fits in 16 bits
+static int exponentFor(long delta)
+{
+    int exponent = 0;
+
+    while (true)
+    {
+        long half = (exponent == 0) ? 0 : (1L << (exponent - 1));
+        long mantissa = (delta + half) >> exponent;
+
+        if (mantissa <= 32767 && mantissa >= -32768)
+        {
+            return exponent;
+        }
+        exponent++;
+    }
+}
+
+// long is 64 bits on most hosts, so the frames are compared one channel at a time
+static void assertFrame(const long *expected, const long *actual)
+{
+    for (int i = 0; i < CAPTURE_CHANNELS; i++)
+    {
+        TEST_ASSERT_TRUE_MESSAGE(expected[i] == actual[i], "captured value differs");
+    }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_ring_wrap_and_trigger_index(void)
+{
+    CaptureBuffer capture(8);
+    long values[CAPTURE_CHANNELS];
+    long read[CAPTURE_CHANNELS];
+    int frame = 0;
+
+    capture.arm(3);
+
+    // many more pre-trigger frames than slots, so the ring wraps several times
+    for (; frame < 21; frame++)
+    {
+        makeFrame(frame, values);
+        capture.addFrame(values);
+    }
+    capture.trigger(123456);
+    TEST_ASSERT_EQUAL_INT(CAPTURE_TRIGGERED, capture.getState());
+    TEST_ASSERT_EQUAL_INT(-1, capture.getTriggerIndex());
+
+    for (; frame < 24; frame++)
+    {
+        TEST_ASSERT_FALSE(capture.isDone());
+        makeFrame(frame, values);
+        capture.addFrame(values);
+    }
+    TEST_ASSERT_TRUE(capture.isDone());
+
+    // frozen: later frames are ignored
+    makeFrame(frame, values);
+    capture.addFrame(values);
+
+    // the last 8 frames, 4 before the trigger frame (20), the trigger frame and 3 after it
+    TEST_ASSERT_EQUAL_INT(8, capture.getStored());
+    TEST_ASSERT_EQUAL_INT(4, capture.getTriggerIndex());
+    TEST_ASSERT_TRUE(capture.getTriggerTime() == 123456);
+
+    capture.rewind();
+    for (int index = 0; index < 8; index++)
+    {
+        makeFrame(16 + index, values);
+        TEST_ASSERT_TRUE(capture.readFrame(read));
+        assertFrame(values, read);
+
+        // random access gives the same frame, without moving the download
+        TEST_ASSERT_TRUE(capture.frameAt(index, read));
+        assertFrame(values, read);
+    }
+    TEST_ASSERT_FALSE(capture.readFrame(read));
+    TEST_ASSERT_FALSE(capture.frameAt(8, read));
+
+    capture.rewind();
+    TEST_ASSERT_TRUE(capture.readFrame(read));
+    makeFrame(16, values);
+    assertFrame(values, read);
+}
+
+static void test_not_readable_until_done(void)
+{
+    CaptureBuffer capture(4);
+    long values[CAPTURE_CHANNELS];
+
+    // nothing is recorded or triggered before arming
+    makeFrame(0, values);
+    capture.addFrame(values);
+    capture.trigger(1);
+    TEST_ASSERT_EQUAL_INT(0, capture.getStored());
+    TEST_ASSERT_EQUAL_INT(CAPTURE_IDLE, capture.getState());
+
+    capture.arm(1);
+    capture.addFrame(values);
+    TEST_ASSERT_FALSE(capture.readFrame(values));
+    TEST_ASSERT_FALSE(capture.frameAt(0, values));
+
+    // a second trigger is ignored
+    capture.trigger(1);
+    capture.trigger(2);
+    capture.addFrame(values);
+    TEST_ASSERT_TRUE(capture.isDone());
+    TEST_ASSERT_TRUE(capture.getTriggerTime() == 1);
+    TEST_ASSERT_EQUAL_INT(0, capture.getTriggerIndex());
+
+    capture.disarm();
+    TEST_ASSERT_EQUAL_INT(CAPTURE_IDLE, capture.getState());
+    TEST_ASSERT_FALSE(capture.readFrame(values));
+}
+
+static void test_full_scale_step_error(void)
+{
+    CaptureBuffer capture(6);
+    // full scale jumps of the 24 bit ADC in both directions, then a quiet frame
+    long frames[6][CAPTURE_CHANNELS] = {
+        {0, 0, 0, 0, 0, 0},
+        {0x7FFFFFL, -0x800000L, 1, -1, 1000, 0x7FFFFFL},
+        {-0x800000L, 0x7FFFFFL, 2, -2, -1000, 0x123456L},
+        {-0x800000L, 0x7FFFFFL, 3, -3, -1001, 0x123457L},
+        {-0x800000L, 0x7FFFFFL, 3, -3, -1001, 0x123457L},
+        {0x7FFFFFL, -0x800000L, 0, 1, -1, 0x7FFFFFL}};
+    long read[CAPTURE_CHANNELS];
+    long previous[CAPTURE_CHANNELS] = {0, 0, 0, 0, 0, 0};
+
+    capture.arm(0);
+    for (int frame = 0; frame < 6; frame++)
+    {
+        capture.addFrame(frames[frame]);
+    }
+    capture.trigger(0);
+    TEST_ASSERT_TRUE(capture.isDone());
+
+    capture.rewind();
+    for (int frame = 0; frame < 6; frame++)
+    {
+        TEST_ASSERT_TRUE(capture.readFrame(read));
+
+        // the deltas of a frame are taken from the previous stored values and share the
+        // exponent of the largest one, so the error is at most half a step of that exponent
+        int exponent = 0;
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            int needed = exponentFor(frames[frame][i] - previous[i]);
+            exponent = (needed > exponent) ? needed : exponent;
+        }
+
+        long limit = (exponent == 0) ? 0 : (1L << (exponent - 1));
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            long error = read[i] - frames[frame][i];
+            TEST_ASSERT_TRUE_MESSAGE(error <= limit && error >= -limit, "step error too large");
+            previous[i] = read[i];
+        }
+    }
+
+    // the rounding is carried into the next delta: after the steps, the quiet frames are exact
+    capture.frameAt(3, read);
+    assertFrame(frames[3], read);
+    capture.frameAt(4, read);
+    assertFrame(frames[4], read);
+}
+
+static void test_step_rounds_to_nearest(void)
+{
+    CaptureBuffer capture(2);
+    // a step of 23437 * 128 counts needs exponent 7, so the small deltas of the frame are
+    // rounded to the nearest multiple of 128
+    long frames[2][CAPTURE_CHANNELS] = {
+        {0, 0, 0, 0, 0, 0},
+        {2999936L, 127, -127, 63, -65, 200}};
+    long expected[CAPTURE_CHANNELS] = {2999936L, 128, -128, 0, -128, 256};
+    long read[CAPTURE_CHANNELS];
+
+    capture.arm(0);
+    capture.addFrame(frames[0]);
+    capture.addFrame(frames[1]);
+    capture.trigger(0);
+    TEST_ASSERT_TRUE(capture.isDone());
+
+    TEST_ASSERT_TRUE(capture.frameAt(1, read));
+    assertFrame(expected, read);
+}
+
+static void test_random_captures(void)
+{
+    long frames[CAPTURE_MAX_FRAMES * 3][CAPTURE_CHANNELS];
+    long read[CAPTURE_CHANNELS];
+
+    for (int capture_index = 0; capture_index < 2000; capture_index++)
+    {
+        CaptureBuffer capture(randomValue(2, CAPTURE_MAX_FRAMES));
+        int size = capture.getFrames();
+        int post = randomValue(0, size - 1);
+        int pre = randomValue(1, 2 * size);
+        // full scale, 16 bit or larger steps
+        long range = 3000000;
+        if (capture_index % 3 == 0)
+        {
+            range = 0x7FFFFFL;
+        }
+        else if (capture_index % 3 == 1)
+        {
+            range = 16000;
+        }
+
+        capture.arm(post);
+        for (int frame = 0; frame < pre + post; frame++)
+        {
+            for (int i = 0; i < CAPTURE_CHANNELS; i++)
+            {
+                frames[frame][i] = randomValue(-range - 1, range);
+            }
+            capture.addFrame(frames[frame]);
+
+            if (frame == pre - 1)
+            {
+                capture.trigger(frame);
+            }
+        }
+        TEST_ASSERT_TRUE(capture.isDone());
+
+        int stored = (pre + post < size) ? pre + post : size;
+        int oldest = pre + post - stored;
+        TEST_ASSERT_EQUAL_INT(stored, capture.getStored());
+        TEST_ASSERT_EQUAL_INT(pre - 1 - oldest, capture.getTriggerIndex());
+
+        // every delta is at most 25 bits: exponent 10, error up to 512 counts
+        capture.rewind();
+        for (int index = 0; index < stored; index++)
+        {
+            TEST_ASSERT_TRUE(capture.readFrame(read));
+            for (int i = 0; i < CAPTURE_CHANNELS; i++)
+            {
+                long error = read[i] - frames[oldest + index][i];
+                TEST_ASSERT_TRUE_MESSAGE(error <= 512 && error >= -512, "step error too large");
+                if (2 * range < 32768)
+                {
+                    TEST_ASSERT_TRUE_MESSAGE(error == 0, "small delta not exact");
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_wrap_and_trigger_index);
+    RUN_TEST(test_not_readable_until_done);
+    RUN_TEST(test_full_scale_step_error);
+    RUN_TEST(test_step_rounds_to_nearest);
+    RUN_TEST(test_random_captures);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+// Conversion of local times to the master clock, run on the host: pio test -e native
+
+#include <unity.h>
+#include <ClockSync.h>
+
+// micros() wraps at 2^32 on the atmega328; long is 64 bits on most hosts, so times and
+// differences are compared as 32 bit values
+static bool near(unsigned long expected, unsigned long actual, long tolerance)
+{
+    int32_t difference = (int32_t)((uint32_t)actual - (uint32_t)expected);
+
+    return difference <= tolerance && difference >= -tolerance;
+}
+
+// master clock running ppm faster than the local one, offset by offset us
+static unsigned long masterTime(unsigned long local_time, long ppm, unsigned long offset)
+{
+    int64_t scaled = (int64_t)local_time * (1000000 + ppm) / 1000000;
+
+    return (uint32_t)(scaled + offset);
+}
+
+// references every 100 ms for the given time, like the master's general call broadcasts
+static unsigned long synchronize(ClockSync &sync, unsigned long start, unsigned long duration,
+                                 long ppm, unsigned long offset)
+{
+    unsigned long local_time = start;
+
+    for (; local_time - start < duration; local_time += 100000)
+    {
+        sync.addReference((uint32_t)local_time, masterTime(local_time, ppm, offset));
+    }
+
+    return local_time - 100000;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_not_synchronized_returns_local_time(void)
+{
+    ClockSync sync;
+
+    TEST_ASSERT_FALSE(sync.isSynchronized());
+    TEST_ASSERT_TRUE(sync.toMaster(1234567) == 1234567);
+
+    sync.addReference(1000, 501000);
+    TEST_ASSERT_TRUE(sync.isSynchronized());
+    TEST_ASSERT_TRUE(sync.toMaster(2000) == 502000);
+    TEST_ASSERT_EQUAL_INT(500000, sync.getOffset());
+}
+
+static void test_skew_is_measured(void)
+{
+    ClockSync sync;
+
+    unsigned long last = synchronize(sync, 1000000, 30000000, 250, 7000000);
+
+    TEST_ASSERT_TRUE(sync.getSkew() >= 248 && sync.getSkew() <= 252);
+    // a frame 80 ms after the last reference
+    TEST_ASSERT_TRUE(near(masterTime(last + 80000, 250, 7000000), sync.toMaster(last + 80000), 2));
+}
+
+static void test_time_just_before_the_reference(void)
+{
+    ClockSync sync;
+
+    // the local clock wraps during the references, and the last one is 30 us after the wrap
+    unsigned long start = 0xFFFFFFFFUL - 19999969UL;
+    unsigned long last = synchronize(sync, start, 20050000, -400, 123456789);
+    TEST_ASSERT_TRUE((uint32_t)last == 30);
+
+    // the ready time of a frame already being built when the last reference arrived: before the
+    // reference, and before the wrap
+    unsigned long before = (uint32_t)(last - 50);
+    TEST_ASSERT_TRUE(before > 0xFFFF0000UL);
+    TEST_ASSERT_TRUE(near(masterTime(last, -400, 123456789) - 50, sync.toMaster(before), 2));
+}
+
+static void test_late_references_are_filtered(void)
+{
+    ClockSync sync;
+    unsigned long local_time = 1000000;
+
+    synchronize(sync, local_time, 10000000, 0, 2000000);
+    local_time += 10000000;
+
+    // every other reference stamped 300 us late, as when a bridge read holds the interrupt off
+    for (int i = 0; i < 50; i++, local_time += 100000)
+    {
+        unsigned long latency = (i % 2) ? 300 : 0;
+        sync.addReference(local_time + latency, masterTime(local_time, 0, 2000000));
+
+        unsigned long frame = local_time + 50000;
+        TEST_ASSERT_TRUE_MESSAGE(near(frame + 2000000, sync.toMaster(frame), 30),
+                                 "late reference moved the offset");
+    }
+    TEST_ASSERT_TRUE(sync.getSkew() >= -20 && sync.getSkew() <= 20);
+}
+
+static void test_master_clock_jump_restarts_the_offset(void)
+{
+    ClockSync sync;
+
+    unsigned long last = synchronize(sync, 1000000, 10000000, 100, 5000000);
+
+    // the master clock is set 5 s back, which looks like a very late reference: it is taken as it
+    // is instead of filtered
+    unsigned long next = last + 100000;
+    sync.addReference(next, masterTime(next, 100, 0));
+
+    TEST_ASSERT_TRUE(near(masterTime(next, 100, 0), sync.toMaster(next), 0));
+    TEST_ASSERT_TRUE(sync.getSkew() >= 95 && sync.getSkew() <= 105);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_not_synchronized_returns_local_time);
+    RUN_TEST(test_skew_is_measured);
+    RUN_TEST(test_time_just_before_the_reference);
+    RUN_TEST(test_late_references_are_filtered);
+    RUN_TEST(test_master_clock_jump_restarts_the_offset);
+    return UNITY_END();
+}
@@ -0,0 +1,195 @@
+// Round trip of the frame encoding, run on the host: pio test -e native
+
+#include <unity.h>
+#include <FrameCodec.h>
+
+// slowly varying HX711 readings, like a loaded bridge with noise
+static void makeFrame(int index, long *values)
+{
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        values[i] = 100000L * (i - 2) + 37L * index + ((index * (i + 3)) % 11) - 5;
+    }
+}
+
+// long is 64 bits on most hosts, so the frames are compared one channel at a time
+static void assertFrame(const long *expected, const long *actual)
+{
+    for (int i = 0; i < FRAME_CODEC_CHANNELS; i++)
+    {
+        TEST_ASSERT_TRUE_MESSAGE(expected[i] == actual[i], "decoded value differs");
+    }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_round_trip(void)
+{
+    FrameEncoder encoder(8);
+    FrameDecoder decoder;
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    long values[FRAME_CODEC_CHANNELS];
+    long decoded[FRAME_CODEC_CHANNELS];
+
+    for (int frame = 0; frame < 100; frame++)
+    {
+        makeFrame(frame, values);
+
+        uint8_t size = encoder.encode(values, buffer, sizeof(buffer));
+        TEST_ASSERT_TRUE(size > 0);
+        TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+        assertFrame(values, decoded);
+    }
+}
+
+static void test_extreme_values(void)
+{
+    FrameEncoder encoder(8);
+    FrameDecoder decoder;
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    // full scale jumps of the 24 bit ADC in both directions
+    long frames[3][FRAME_CODEC_CHANNELS] = {
+        {0x7FFFFFL, -0x800000L, 0, 1, -1, 0x7FFFFFL},
+        {-0x800000L, 0x7FFFFFL, -1, 0, 1, -0x800000L},
+        {0x7FFFFFL, -0x800000L, 0, 1, -1, 0x7FFFFFL}};
+    long decoded[FRAME_CODEC_CHANNELS];
+
+    for (int frame = 0; frame < 3; frame++)
+    {
+        uint8_t size = encoder.encode(frames[frame], buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+        assertFrame(frames[frame], decoded);
+    }
+}
+
+static void test_small_deltas_are_compact(void)
+{
+    FrameEncoder encoder(32);
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    long values[FRAME_CODEC_CHANNELS];
+    int total = 0;
+
+    for (int frame = 0; frame < 64; frame++)
+    {
+        makeFrame(frame, values);
+        total += encoder.encode(values, buffer, sizeof(buffer));
+    }
+
+    // six 4 byte longs are 24 bytes per frame; keyframes included, the average stays under 10
+    TEST_ASSERT_TRUE(total < 64 * 10);
+}
+
+static void test_sequence_gap_waits_for_keyframe(void)
+{
+    FrameEncoder encoder(8);
+    FrameDecoder decoder;
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    long values[FRAME_CODEC_CHANNELS];
+    long decoded[FRAME_CODEC_CHANNELS];
+    int frame = 0;
+
+    // in sync after the first keyframe
+    makeFrame(frame++, values);
+    uint8_t size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(buffer[0] & FRAME_CODEC_KEYFRAME);
+    TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+
+    // one frame lost on the bus
+    makeFrame(frame++, values);
+    encoder.encode(values, buffer, sizeof(buffer));
+
+    // the deltas after the gap are refused instead of decoded against the wrong frame
+    bool resynchronized = false;
+    for (; frame < 8 + 2; frame++)
+    {
+        makeFrame(frame, values);
+        size = encoder.encode(values, buffer, sizeof(buffer));
+
+        int result = decoder.decode(buffer, size, decoded);
+
+        if (buffer[0] & FRAME_CODEC_KEYFRAME)
+        {
+            TEST_ASSERT_EQUAL_INT(size, result);
+            assertFrame(values, decoded);
+            resynchronized = true;
+            break;
+        }
+
+        TEST_ASSERT_EQUAL_INT(-1, result);
+        TEST_ASSERT_FALSE(decoder.isSynchronized());
+    }
+    TEST_ASSERT_TRUE(resynchronized);
+
+    // and the deltas after the keyframe decode again
+    makeFrame(++frame, values);
+    size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+    assertFrame(values, decoded);
+}
+
+static void test_requested_keyframe(void)
+{
+    FrameEncoder encoder(32);
+    FrameDecoder decoder;
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    long values[FRAME_CODEC_CHANNELS];
+    long decoded[FRAME_CODEC_CHANNELS];
+
+    makeFrame(0, values);
+    encoder.encode(values, buffer, sizeof(buffer));
+
+    // the decoder missed the first keyframe, and the master asks for another one
+    makeFrame(1, values);
+    uint8_t size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(-1, decoder.decode(buffer, size, decoded));
+
+    encoder.requestKeyframe();
+    makeFrame(2, values);
+    size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(buffer[0] & FRAME_CODEC_KEYFRAME);
+    TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+    assertFrame(values, decoded);
+}
+
+static void test_frame_that_does_not_fit(void)
+{
+    FrameEncoder encoder(8);
+    FrameDecoder decoder;
+    uint8_t buffer[FRAME_CODEC_MAX_SIZE];
+    long values[FRAME_CODEC_CHANNELS];
+    long decoded[FRAME_CODEC_CHANNELS];
+
+    makeFrame(0, values);
+
+    // nothing is written and the encoder state is kept, so the frame can be sent later
+    TEST_ASSERT_EQUAL_INT(0, encoder.encode(values, buffer, 4));
+
+    uint8_t size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_TRUE(buffer[0] & FRAME_CODEC_KEYFRAME);
+    TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+    assertFrame(values, decoded);
+
+    // an incomplete frame is not consumed
+    makeFrame(1, values);
+    size = encoder.encode(values, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(0, decoder.decode(buffer, size - 1, decoded));
+    TEST_ASSERT_EQUAL_INT(size, decoder.decode(buffer, size, decoded));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_extreme_values);
+    RUN_TEST(test_small_deltas_are_compact);
+    RUN_TEST(test_sequence_gap_waits_for_keyframe);
+    RUN_TEST(test_requested_keyframe);
+    RUN_TEST(test_frame_that_does_not_fit);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+// Statistics of one channel against sums computed directly, run on the host: pio test -e native
+
+#include <unity.h>
+#include <RunningStatistics.h>
+#include <math.h>
+
+// 24 bit HX711 readings around a level, with deterministic noise
+static long makeValue(long level, int index)
+{
+    return level + ((index * 7919L) % 2001) - 1000;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void test_mean_and_variance_after_recentering(void)
+{
+    RunningStatistics statistics;
+    // the first sample is the initial reference: a step of 50000 counts after it makes the sum
+    // of the deviations cross the recentering limit after ~21000 samples, and again later
+    long before = -0x600000L;
+    long after = before + 50000;
+    int steps = 10000;
+    int samples = 100000;
+
+    int64_t sum = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        long value = makeValue((i < steps) ? before : after, i);
+        sum += value;
+        statistics.addValue(value, i);
+    }
+
+    double mean = (double)sum / samples;
+    double squares = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        double deviation = makeValue((i < steps) ? before : after, i) - mean;
+        squares += deviation * deviation;
+    }
+    double variance = squares / samples;
+
+    TEST_ASSERT_TRUE(statistics.getCount() == (unsigned long)samples);
+    TEST_ASSERT_TRUE(fabs(statistics.getMean() - mean) <= 0.5);
+    // integer sums, so only the final divisions round
+    TEST_ASSERT_TRUE(fabs(statistics.getVariance() - variance) <= 1.0);
+    TEST_ASSERT_TRUE(statistics.getMin() == before - 1000);
+    TEST_ASSERT_TRUE(statistics.getMax() == after + 1000);
+
+    // float square root: relative error of the float mantissa
+    double rms = sqrt(mean * mean + variance);
+    TEST_ASSERT_TRUE(fabs(statistics.getRms() - rms) <= rms * 1e-6 + 1);
+}
+
+static void test_peak_keeps_the_largest_magnitude(void)
+{
+    RunningStatistics statistics;
+
+    statistics.addValue(100, 10);
+    statistics.addValue(-300, 20);
+    statistics.addValue(250, 30);
+    statistics.addValue(-300, 40);
+
+    TEST_ASSERT_TRUE(statistics.getPeak() == -300);
+    // ties keep the first time the magnitude was reached
+    TEST_ASSERT_TRUE(statistics.getPeakTime() == 20);
+}
+
+static void test_reset_starts_a_new_window(void)
+{
+    RunningStatistics statistics;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        statistics.addValue(makeValue(-0x700000L, i), i);
+    }
+
+    statistics.reset();
+    TEST_ASSERT_TRUE(statistics.getCount() == 0);
+    TEST_ASSERT_TRUE(statistics.getMean() == 0);
+    TEST_ASSERT_TRUE(statistics.getVariance() == 0);
+    TEST_ASSERT_TRUE(statistics.getRms() == 0);
+
+    // nothing from the previous window: extremes, peak and sums start over
+    statistics.addValue(10, 5000);
+    statistics.addValue(20, 5001);
+    statistics.addValue(30, 5002);
+
+    TEST_ASSERT_TRUE(statistics.getCount() == 3);
+    TEST_ASSERT_TRUE(statistics.getMin() == 10);
+    TEST_ASSERT_TRUE(statistics.getMax() == 30);
+    TEST_ASSERT_TRUE(statistics.getMean() == 20);
+    // (100 + 0 + 100) / 3
+    TEST_ASSERT_TRUE(statistics.getVariance() == 66);
+    TEST_ASSERT_TRUE(statistics.getPeak() == 30);
+    TEST_ASSERT_TRUE(statistics.getPeakTime() == 5002);
+}
+
+static void test_negative_mean_rounds_to_nearest(void)
+{
+    RunningStatistics statistics;
+
+    statistics.addValue(-10, 0);
+    statistics.addValue(-11, 1);
+    statistics.addValue(-11, 2);
+
+    // -10.67
+    TEST_ASSERT_TRUE(statistics.getMean() == -11);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_mean_and_variance_after_recentering);
+    RUN_TEST(test_peak_keeps_the_largest_magnitude);
+    RUN_TEST(test_reset_starts_a_new_window);
+    RUN_TEST(test_negative_mean_rounds_to_nearest);
+    return UNITY_END();
+}